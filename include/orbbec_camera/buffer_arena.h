@@ -0,0 +1,122 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace orbbec_camera {
+
+// Frame buffers mapped ahead of time and grouped in named pools, e.g. one per
+// stream and use. Released buffers go back to their pool, so once the pools
+// are warm the frame path does not allocate, and the memory held is bounded
+// by the most buffers a pool ever had in use. The memory can be locked in RAM
+// or backed by huge pages. Thread-safe.
+class BufferArena {
+ public:
+  enum class Backing { DEFAULT, LOCKED, HUGE_PAGES };
+
+  struct Stats {
+    size_t reserved_bytes = 0;    // mapped by all pools
+    size_t in_use_bytes = 0;      // held by acquired buffers
+    size_t high_water_bytes = 0;  // the maximum of in_use_bytes
+    uint64_t acquisitions = 0;
+    uint64_t misses = 0;  // acquisitions that had to map a new buffer
+  };
+
+  // A buffer of a pool, returned to it when reset or destroyed.
+  class Buffer {
+   public:
+    Buffer() = default;
+
+    Buffer(Buffer &&other) noexcept { *this = std::move(other); }
+
+    Buffer &operator=(Buffer &&other) noexcept;
+
+    Buffer(const Buffer &) = delete;
+
+    Buffer &operator=(const Buffer &) = delete;
+
+    ~Buffer() { reset(); }
+
+    uint8_t *data() const { return data_; }
+
+    size_t size() const { return size_; }
+
+    explicit operator bool() const { return data_ != nullptr; }
+
+    void reset();
+
+   private:
+    friend class BufferArena;
+
+    BufferArena *arena_ = nullptr;
+    size_t pool_ = 0;
+    uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+  };
+
+  explicit BufferArena(Backing backing = Backing::DEFAULT) : backing_(backing) {}
+
+  BufferArena(const BufferArena &) = delete;
+
+  BufferArena &operator=(const BufferArena &) = delete;
+
+  // All buffers must have been released.
+  ~BufferArena();
+
+  // Maps count more free buffers of size bytes in pool.
+  void reserve(const std::string &pool, size_t size, int count);
+
+  // Takes a free buffer of at least size bytes from pool, mapping a new one if
+  // there is none. Returns an empty buffer if mapping fails.
+  Buffer acquire(const std::string &pool, size_t size);
+
+  Stats stats() const;
+
+  Backing backing() const { return backing_; }
+
+ private:
+  struct Block {
+    uint8_t *data;
+    size_t capacity;
+    bool in_use;
+  };
+
+  struct Pool {
+    std::string name;
+    std::vector<Block> blocks;
+  };
+
+  size_t findPool(const std::string &name);
+
+  bool mapBlock(size_t size, Block &block);
+
+  void release(size_t pool, uint8_t *data);
+
+  const Backing backing_;
+  mutable std::mutex mutex_;
+  std::vector<Pool> pools_;
+  Stats stats_;
+  bool warned_ = false;
+};
+
+}  // namespace orbbec_camera
@@ -45,10 +45,26 @@ const bool POINTCLOUD = false;
 const bool ALLOW_NO_TEXTURE_POINTS = false;
 const bool SYNC_FRAMES = false;
 const bool ORDERED_POINTCLOUD = false;
+const double POINT_CLOUD_MIN_DISTANCE = 0.02;  // meters
+const double POINT_CLOUD_MAX_DISTANCE = 10.0;  // meters
+const double DEFAULT_VOXEL_LEAF_SIZE = 0.05;                 // meters
+const std::string DEFAULT_VOXEL_SELECTION = "centroid";      // centroid, first
+const std::string DEFAULT_POINT_CLOUD_ENCODING = "float32";  // float32, int16, float16
+// Messages per publisher kept for reuse, one more than the publisher queue size is
+// enough for a subscriber that processes frames at the camera rate.
+const size_t MESSAGE_POOL_SIZE = 3;
+// Color frame sets decoding or waiting to be published before new ones are dropped.
+const int DEFAULT_COLOR_DECODE_MAX_IN_FLIGHT = 4;
+const std::string DEFAULT_COLOR_OUTPUT_ENCODING = "rgb8";  // rgb8, native
+const std::string DEFAULT_COLOR_YUV_MATRIX = "bt601";  // bt601, bt709
+
+const std::string DEFAULT_FRAME_BUFFER_MEMORY = "default";  // default, locked, huge_pages
+// color/image_preview is 1/scale of the color resolution, one of 2, 4 or 8.
+const int DEFAULT_COLOR_PREVIEW_SCALE = 4;
 
 const bool PUBLISH_TF = true;
 const double TF_PUBLISH_RATE = 0;     // Static transform
-const double DIAGNOSTICS_PERIOD = 0;  // Static transform
+const double DIAGNOSTICS_PERIOD = 1.0;  // seconds, 0 disables the latency diagnostics
 
 const int IMAGE_WIDTH = 640;
 const int IMAGE_HEIGHT = 480;
@@ -89,7 +105,13 @@ const std::string DEFAULT_ALIGNED_DEPTH_TO_INFRA2_FRAME_ID = "camera_aligned_dep
 const std::string DEFAULT_ALIGNED_DEPTH_TO_FISHEYE_FRAME_ID =
     "camera_aligned_depth_to_fisheye_frame";
 
-const std::string DEFAULT_UNITE_IMU_METHOD = "";
+const std::string DEFAULT_UNITE_IMU_METHOD = "";  // copy, linear_interpolation
+// Gyro samples waiting for the next accel sample to be interpolated with.
+const int UNITE_IMU_HISTORY_SIZE = 64;
+// IMU samples waiting for the IMU publisher thread, per sensor.
+const int IMU_RING_SIZE = 1024;
+const double DEFAULT_IMU_ORIENTATION_RATE = 50.0;  // Hz
+const double DEFAULT_IMU_ORIENTATION_GAIN = 0.1;
 const std::string DEFAULT_FILTERS = "";
 const std::string DEFAULT_TOPIC_ODOM_IN = "";
 const std::string DEFAULT_D2C_MODE = "sw";  // sw = software mode, hw=hardware mode, none,
@@ -0,0 +1,53 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace orbbec_camera {
+
+// Converts raw depth values to millimeters by the depth frame value scale. The
+// conversion is picked once per scale: a copy for 1.0, a shift for powers of
+// two and a float multiply otherwise. Results are rounded to nearest even and
+// saturated, matching cv::Mat::convertTo.
+class DepthScaler {
+ public:
+  enum class Mode { IDENTITY, SHIFT, MULTIPLY };
+
+  // Picks the conversion for scale. Cheap when the scale did not change.
+  void setScale(float scale);
+
+  float scale() const { return scale_; }
+
+  Mode mode() const { return mode_; }
+
+  bool isIdentity() const { return mode_ == Mode::IDENTITY; }
+
+  // Scales count values of in into out, in and out may be the same buffer.
+  // If meters is not null, it also receives the scaled depth in meters as
+  // 32-bit floats in the same pass, with NaN for zero (invalid) depth.
+  void apply(const uint16_t *in, uint16_t *out, float *meters, size_t count) const;
+
+ private:
+  float scale_ = 1.0f;
+  Mode mode_ = Mode::IDENTITY;
+  int shift_ = 0;  // left shift if positive, rounding right shift if negative
+};
+
+}  // namespace orbbec_camera
@@ -0,0 +1,31 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace orbbec_camera {
+
+// Mirrors a width x height image of pixel_size-byte pixels (1, 2, 3 or 4) left
+// to right while copying it from src to dst. Steps are in bytes. src and dst may
+// be the same buffer, which flips the image in place.
+void flipImageHorizontal(const uint8_t *src, size_t src_step, uint8_t *dst, size_t dst_step,
+                         int width, int height, int pixel_size);
+
+}  // namespace orbbec_camera
@@ -0,0 +1,103 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace orbbec_camera {
+
+// Latency histograms of the frame processing stages. Recording is lock-free
+// and may happen from any thread. The histogram buckets are spaced
+// logarithmically, four per power of two microseconds, so percentiles are
+// accurate to about 12%.
+class LatencyStats {
+ public:
+  struct Summary {
+    std::string name;
+    uint64_t count = 0;
+    double rate = 0.0;  // records per second
+    double p50_ms = 0.0;
+    double p99_ms = 0.0;
+    double max_ms = 0.0;
+  };
+
+  // Records the time from its construction to its destruction. Does nothing
+  // with null stats or a negative stage.
+  class ScopedTimer {
+   public:
+    ScopedTimer(LatencyStats *stats, int stage)
+        : stats_(stage >= 0 ? stats : nullptr), stage_(stage) {
+      if (stats_) {
+        start_ = std::chrono::steady_clock::now();
+      }
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+    ~ScopedTimer() {
+      if (stats_) {
+        stats_->record(stage_, std::chrono::steady_clock::now() - start_);
+      }
+    }
+
+   private:
+    LatencyStats *stats_;
+    int stage_;
+    std::chrono::steady_clock::time_point start_;
+  };
+
+  LatencyStats();
+
+  // Adds a stage and returns its index. All stages must be added before recording.
+  int addStage(const std::string &name);
+
+  void record(int stage, std::chrono::nanoseconds latency);
+
+  // Records the time since timestamp_ms, a system clock timestamp in milliseconds.
+  void recordSince(int stage, uint64_t timestamp_ms);
+
+  // Summaries of the stages recorded since the previous call, which are cleared.
+  // Call from one thread at a time.
+  std::vector<Summary> collect();
+
+ private:
+  static const int BUCKET_COUNT = 128;
+
+  struct Stage {
+    std::string name;
+    std::array<std::atomic<uint32_t>, BUCKET_COUNT> buckets;
+    std::atomic<uint64_t> max_us{0};
+  };
+
+  static int bucketIndex(uint64_t us);
+
+  // The middle of the bucket, in microseconds.
+  static double bucketValue(int bucket);
+
+  std::vector<std::unique_ptr<Stage>> stages_;
+  std::chrono::steady_clock::time_point collected_;
+};
+
+}  // namespace orbbec_camera
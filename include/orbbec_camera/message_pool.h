@@ -0,0 +1,101 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+#include <sensor_msgs/PointCloud2.h>
+#include "constants.h"
+
+namespace orbbec_camera {
+
+// Small pool of messages published by shared pointer. A message is handed out
+// again only once nobody else holds it (use_count() == 1), so intra-process
+// subscribers never see a published message change, while its buffers keep
+// their capacity across frames. Not thread safe, acquire from a single thread.
+template <typename MessageT>
+class MessagePool {
+ public:
+  using MessagePtr = boost::shared_ptr<MessageT>;
+
+  explicit MessagePool(size_t max_size = MESSAGE_POOL_SIZE) : max_size_(max_size) {
+    messages_.reserve(max_size_);
+  }
+
+  // Returns a message that is not referenced by any subscriber. If all pooled
+  // messages are still in use and the pool is full, a fresh unpooled message
+  // is returned.
+  MessagePtr acquire() {
+    for (size_t i = 0; i < messages_.size(); i++) {
+      // Start after the last message handed out to give subscribers the most time.
+      auto &message = messages_[(next_ + i) % messages_.size()];
+      if (message.use_count() == 1) {
+        next_ = (next_ + i + 1) % messages_.size();
+        return message;
+      }
+    }
+    auto message = boost::make_shared<MessageT>();
+    if (messages_.size() < max_size_) {
+      messages_.push_back(message);
+      next_ = 0;
+    }
+    return message;
+  }
+
+  size_t size() const { return messages_.size(); }
+
+ private:
+  size_t max_size_;
+  size_t next_ = 0;
+  std::vector<MessagePtr> messages_;
+};
+
+// Field layout of a PointCloud2, built once per configuration and copied into
+// pooled messages the first time they are used.
+struct PointCloudLayout {
+  std::vector<sensor_msgs::PointField> fields;
+  uint32_t point_step = 0;
+
+  // Sets the layout of msg unless it already has it.
+  void apply(sensor_msgs::PointCloud2 &msg) const {
+    if (!matches(msg)) {
+      msg.fields = fields;
+      msg.point_step = point_step;
+      msg.is_bigendian = false;
+    }
+  }
+
+  bool matches(const sensor_msgs::PointCloud2 &msg) const {
+    if (msg.point_step != point_step || msg.fields.size() != fields.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < fields.size(); i++) {
+      const auto &field = msg.fields[i];
+      if (field.offset != fields[i].offset || field.datatype != fields[i].datatype ||
+          field.count != fields[i].count || field.name != fields[i].name) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+}  // namespace orbbec_camera
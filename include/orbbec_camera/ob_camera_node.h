@@ -22,6 +22,7 @@
 #include <opencv2/opencv.hpp>
 #include <cv_bridge/cv_bridge.h>
 #include <sensor_msgs/CameraInfo.h>
+#include <sensor_msgs/CompressedImage.h>
 #include <sensor_msgs/PointCloud2.h>
 #include <sensor_msgs/distortion_models.h>
 #include <sensor_msgs/Imu.h>
@@ -31,18 +32,36 @@
 #include <tf2/LinearMath/Vector3.h>
 #include <tf2_ros/static_transform_broadcaster.h>
 #include <tf2_ros/transform_broadcaster.h>
+#include <array>
 #include <condition_variable>
 #include <thread>
+#include <tuple>
 #include <camera_info_manager/camera_info_manager.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
 #include <std_srvs/SetBool.h>
 #include <std_srvs/Empty.h>
 #include "orbbec_camera/d2c_viewer.h"
 #include "orbbec_camera/GetCameraParams.h"
+#include "orbbec_camera/ImuBatch.h"
 #include <boost/optional.hpp>
 
+#include "buffer_arena.h"
+#include "depth_scale.h"
+#include "image_flip.h"
 #include "jpeg_decoder.h"
+#include "latency_stats.h"
+#include "message_pool.h"
+#include "ordered_frame_decoder.h"
+#include "orientation_filter.h"
+#include "point_cloud_encoding.h"
+#include "point_cloud_kernel.h"
+#include "spsc_ring.h"
+#include "voxel_grid.h"
+#include "yuv_convert.h"
 
 namespace orbbec_camera {
+class TurboJPEGDecoder;
+
 class OBCameraNode {
  public:
   OBCameraNode(ros::NodeHandle& nh, ros::NodeHandle& nh_private,
@@ -65,6 +84,17 @@ class OBCameraNode {
     double timestamp_ = -1;  // in nanoseconds
   };
 
+  enum class UniteIMUMethod { NONE, COPY, LINEAR_INTERPOLATION };
+
+  // An IMU topic and its batched topic, used by the IMU publisher thread only.
+  struct IMUOutput {
+    ros::Publisher publisher;
+    ros::Publisher batch_publisher;
+    sensor_msgs::Imu msg;
+    ImuBatch batch;
+    size_t batch_count = 0;
+  };
+
   void init();
 
   void setupCameraCtrlServices();
@@ -83,17 +113,95 @@ class OBCameraNode {
 
   void readDefaultWhiteBalance();
 
+  // Returns the libjpeg-turbo decoder when it is built and enabled, nullptr otherwise.
+  std::shared_ptr<JPEGDecoder> createSoftwareMJPEGDecoder();
+
   std::shared_ptr<ob::Frame> softwareDecodeColorFrame(const std::shared_ptr<ob::Frame>& frame);
 
+  std::shared_ptr<ob::Frame> softwareDecodeColorFrame(const std::shared_ptr<ob::Frame>& frame,
+                                                      ob::FormatConvertFilter& filter);
+
   void onNewFrameCallback(const std::shared_ptr<ob::Frame>& frame,
                           const stream_index_pair& stream_index);
 
+  // Queues the sample for imuPublishThread().
   void onNewIMUFrameCallback(const std::shared_ptr<ob::Frame>& frame,
                              const stream_index_pair& stream_index);
 
+  // Wakes imuPublishThread() if it is waiting for samples.
+  void notifyIMUPublisher();
+
+  // Publishes the queued IMU samples of both sensors in timestamp order.
+  void imuPublishThread();
+
+  void processIMUSample(const IMUData& data);
+
+  // Publishes output.msg, and adds it to the batch of output.
+  void publishIMU(IMUOutput& output);
+
+  // Merges the accel and gyro samples into imu/sample at the gyro rate.
+  void uniteIMUSample(const IMUData& data);
+
+  // Runs the orientation filter, publishing imu/orientation at imu_orientation_rate_.
+  void updateIMUOrientation(const IMUData& data);
+
+  // The accel sample at timestamp, interpolated between the last two accel samples.
+  IMUData interpolateAccel(double timestamp) const;
+
+  void publishUnitedIMU(const IMUData& accel_data, const IMUData& gyro_data);
+
+  void resetUnitedIMU();
+
   bool decodeColorFrameToBuffer(const std::shared_ptr<ob::Frame>& frame, uint8_t* dest);
 
-  std::shared_ptr<ob::Frame> decodeIRMJPGFrame(const std::shared_ptr<ob::Frame> &frame);
+  // Converts a YUV color frame to RGB with yuv_converter_.
+  bool convertYUVFrame(const std::shared_ptr<ob::VideoFrame>& frame, uint8_t* dest,
+                       size_t dest_step);
+
+  bool hasColorSubscriber();
+
+  // Decodes the color frame of frame_set on a color_decoder_ worker.
+  bool decodeColorFrameSet(int worker, const std::shared_ptr<ob::FrameSet>& frame_set,
+                           std::vector<uint8_t>& buffer);
+
+  void onDecodedFrameSet(const std::shared_ptr<ob::FrameSet>& frame_set, const uint8_t* rgb);
+
+  // Publishes the point clouds and images of frame_set, rgb is its decoded color frame.
+  void publishFrameSet(const std::shared_ptr<ob::FrameSet>& frame_set, const uint8_t* rgb);
+
+  // Publishes color/image_preview, decoded at reduced scale from MJPG when libjpeg-turbo is
+  // available, otherwise downscaled from the decoded color frame.
+  void publishColorPreview(const std::shared_ptr<ob::ColorFrame>& frame);
+
+  // Whether color/image_preview is decoded from MJPG without the full resolution decode.
+  bool canDecodeColorPreview();
+
+  // Publishes color/image_mono, the Y plane of YUV frames or the luma-only decode of MJPG when
+  // libjpeg-turbo is available, otherwise converted from the decoded color frame.
+  void publishColorMono(const std::shared_ptr<ob::ColorFrame>& frame);
+
+  // Whether color/image_mono is computed without the full resolution RGB decode.
+  bool canDecodeColorMono();
+
+  // Publishes the MJPG payload of frame on color/image_raw/compressed without decoding it.
+  void publishColorCompressed(const std::shared_ptr<ob::ColorFrame>& frame);
+
+  // Publishes the color frame on color/image_raw in its native encoding, without conversion.
+  void publishNativeColorImage(const std::shared_ptr<ob::VideoFrame>& frame,
+                               const ros::Time& timestamp, const std::string& frame_id);
+
+  // Acquires an image message of pool stamped like the color frame.
+  sensor_msgs::ImagePtr acquireColorImage(MessagePool<sensor_msgs::Image>& pool,
+                                          const std::shared_ptr<ob::ColorFrame>& frame, int width,
+                                          int height, const std::string& encoding,
+                                          int pixel_size);
+
+  // Decodes an IR MJPG frame into ir_decoded_images_[stream_index].
+  bool decodeIRMJPGFrame(const std::shared_ptr<ob::VideoFrame>& frame,
+                         const stream_index_pair& stream_index);
+
+  // Decodes the subscribed IR MJPG frames of frame_set, the left and right ones concurrently.
+  void decodeIRMJPGFrames(const std::shared_ptr<ob::FrameSet>& frame_set);
 
   void onNewFrameSetCallback(const std::shared_ptr<ob::FrameSet>& frame_set);
 
@@ -103,16 +211,42 @@ class OBCameraNode {
 
   void publishColoredPointCloud(const std::shared_ptr<ob::FrameSet>& frame_set);
 
+  void publishDownsampledPointCloud(const sensor_msgs::PointCloud2& cloud_msg);
+
+  // Returns cloud_msg re-encoded with point_cloud_encoding_ into a message of pool,
+  // or cloud_msg itself for float32.
+  sensor_msgs::PointCloud2Ptr encodePointCloud(const sensor_msgs::PointCloud2Ptr& cloud_msg,
+                                               bool colored,
+                                               MessagePool<sensor_msgs::PointCloud2>& pool);
+
   bool setupFormatConvertType(OBFormat type);
 
+  bool setupFormatConvertType(OBFormat type, ob::FormatConvertFilter& filter);
+
   void setupProfiles();
 
   void setupTopics();
 
+  void setupPointCloudLayouts();
+
   void setupPipelineConfig();
 
   void setupPublishers();
 
+  // Registers the latency stages and publishes them on /diagnostics every diagnostics_period_.
+  void setupLatencyStats();
+
+  // The latency stage of stream_index in stages, or -1.
+  int latencyStage(const std::map<stream_index_pair, int>& stages,
+                   const stream_index_pair& stream_index) const;
+
+  void publishDiagnostics();
+
+  // Advertises name/sample, and name/sample_batch if imu_batch_size_ is set.
+  void setupIMUOutput(IMUOutput& output, const std::string& name, const std::string& frame_id,
+                      const ros::SubscriberStatusCallback& subscribed_cb,
+                      const ros::SubscriberStatusCallback& unsubscribed_cb);
+
   void publishStaticTF(const ros::Time& t, const tf2::Vector3& trans, const tf2::Quaternion& q,
                        const std::string& from, const std::string& to);
 
@@ -134,12 +268,16 @@ class OBCameraNode {
 
   void setDefaultIMUMessage(sensor_msgs::Imu& imu_msg);
 
-  sensor_msgs::Imu createUnitIMUMessage(const IMUData& accel_data, const IMUData& gyro_data);
+  void createUnitIMUMessage(const IMUData& accel_data, const IMUData& gyro_data,
+                            sensor_msgs::Imu& imu_msg);
 
   void startStream(const stream_index_pair& stream_index);
 
   void stopStream(const stream_index_pair& stream_index);
 
+  // True if the image topic of stream_index, or for depth its meters topic, has subscribers.
+  bool hasImageSubscriber(const stream_index_pair& stream_index);
+
   void imageSubscribedCallback(const stream_index_pair& stream_index);
 
   void imuSubscribedCallback(const stream_index_pair& stream_index);
@@ -148,6 +286,14 @@ class OBCameraNode {
 
   void imuUnsubscribedCallback(const stream_index_pair& stream_index);
 
+  // True if the sample or batched topic stream_index is published on has subscribers.
+  bool hasIMUSubscriber(const stream_index_pair& stream_index);
+
+  // Start and stop both IMU sensors, for imu/sample and imu/orientation.
+  void unitedIMUSubscribedCallback();
+
+  void unitedIMUUnsubscribedCallback();
+
   void pointCloudSubscribedCallback();
 
   void pointCloudUnsubscribedCallback();
@@ -168,6 +314,19 @@ class OBCameraNode {
 
   boost::optional<OBCameraParam> getCameraColorParam();
 
+  // Calibration of a stream at a resolution, aligned to color or not. Looked up
+  // on the device once and cached until invalidateCalibrationCache().
+  boost::optional<OBCameraParam> getCalibration(const stream_index_pair& stream_index, int width,
+                                                int height, bool aligned);
+
+  // Copies the cached CameraInfo of the calibration into camera_info, header
+  // excepted. Returns false if there is no calibration.
+  bool getCameraInfo(const stream_index_pair& stream_index, int width, int height, bool aligned,
+                     sensor_msgs::CameraInfo& camera_info);
+
+  // Called when the profiles, the depth work mode or the depth precision change.
+  void invalidateCalibrationCache();
+
   int getCameraParamIndex();
 
   void setupCameraInfo();
@@ -218,6 +377,8 @@ class OBCameraNode {
 
   bool getSDKVersionCallback(GetStringRequest& request, GetStringResponse& response);
 
+  bool getLatencyStatsCallback(GetStringRequest& request, GetStringResponse& response);
+
   bool toggleSensorCallback(std_srvs::SetBoolRequest& request, std_srvs::SetBoolResponse& response,
                             const stream_index_pair& stream_index);
   bool saveImagesCallback(std_srvs::EmptyRequest& request, std_srvs::EmptyResponse& response);
@@ -253,6 +414,17 @@ class OBCameraNode {
 
   bool switchIRDataSourceChannelCallback(SetStringRequest& request, SetStringResponse& response);
 
+  bool setPointCloudFilterCallback(SetPointCloudFilterRequest& request,
+                                   SetPointCloudFilterResponse& response);
+
+  // Validates and applies the point cloud filter of the parameters and the service. filter holds
+  // the ROI and the box, a box_min equal to box_max disables the box. Returns an empty string on
+  // success, otherwise the reason the filter was rejected.
+  std::string setPointCloudFilter(double min_distance, double max_distance, DepthFilter filter);
+
+  // Returns the point cloud filter with the depth range converted to raw depth units.
+  DepthFilter getDepthFilter(double depth_scale);
+
  private:
   ros::NodeHandle nh_;
   ros::NodeHandle nh_private_;
@@ -265,7 +437,26 @@ class OBCameraNode {
   std::map<stream_index_pair, int> fps_;
   std::map<stream_index_pair, ob_format> format_;  // for open stream
   std::map<stream_index_pair, std::string> encoding_;
-  std::map<stream_index_pair, cv::Mat> images_;
+  // One per enabled stream, created in setupPublishers().
+  std::map<stream_index_pair, MessagePool<sensor_msgs::Image>> image_pools_;
+  bool enable_depth_meters_ = false;
+  ros::Publisher depth_meters_pub_;
+  MessagePool<sensor_msgs::Image> depth_meters_pool_;
+  std::string color_output_encoding_ = DEFAULT_COLOR_OUTPUT_ENCODING;
+  bool publish_native_color_ = false;
+  YUVConverter yuv_converter_;
+  bool enable_color_preview_ = false;
+  int color_preview_scale_ = DEFAULT_COLOR_PREVIEW_SCALE;
+  ros::Publisher color_preview_pub_;
+  MessagePool<sensor_msgs::Image> color_preview_pool_;
+  std::shared_ptr<TurboJPEGDecoder> color_preview_decoder_;
+  bool enable_color_mono_ = false;
+  ros::Publisher color_mono_pub_;
+  MessagePool<sensor_msgs::Image> color_mono_pool_;
+  std::shared_ptr<TurboJPEGDecoder> color_mono_decoder_;
+  ros::Publisher color_compressed_pub_;
+  MessagePool<sensor_msgs::CompressedImage> color_compressed_pool_;
+  DepthScaler depth_scaler_;
   std::map<stream_index_pair, int> image_format_;  // for cv_bridge
   std::map<stream_index_pair, int> unit_step_size_;
   std::map<stream_index_pair, bool> enable_stream_;
@@ -317,10 +508,12 @@ class OBCameraNode {
   ros::ServiceServer get_serial_number_srv_;
   ros::ServiceServer get_camera_params_srv_;
   ros::ServiceServer get_device_type_srv_;
+  ros::ServiceServer get_latency_stats_srv_;
   ros::ServiceServer save_point_cloud_srv_;
   ros::ServiceServer save_images_srv_;
   ros::ServiceServer switch_ir_mode_srv_;
   ros::ServiceServer switch_ir_data_source_channel_srv_;
+  ros::ServiceServer set_point_cloud_filter_srv_;
 
   bool publish_tf_ = true;
   std::shared_ptr<tf2_ros::StaticTransformBroadcaster> static_tf_broadcaster_ = nullptr;
@@ -342,14 +535,44 @@ class OBCameraNode {
   std::shared_ptr<ob::Pipeline> pipeline_ = nullptr;
   std::shared_ptr<ob::Config> pipeline_config_ = nullptr;
   ros::Publisher depth_cloud_pub_;
+  ros::Publisher depth_cloud_downsampled_pub_;
   ros::Publisher depth_registered_cloud_pub_;
-  sensor_msgs::PointCloud2 cloud_msg_;
+  PointCloudLayout depth_cloud_layout_;
+  PointCloudLayout colored_cloud_layout_;
+  PointCloudLayout quantized_cloud_layout_;
+  PointCloudLayout quantized_colored_cloud_layout_;
+  MessagePool<sensor_msgs::PointCloud2> depth_cloud_pool_;
+  MessagePool<sensor_msgs::PointCloud2> colored_cloud_pool_;
+  MessagePool<sensor_msgs::PointCloud2> downsampled_cloud_pool_;
+  MessagePool<sensor_msgs::PointCloud2> quantized_cloud_pool_;
+  MessagePool<sensor_msgs::PointCloud2> quantized_colored_cloud_pool_;
+  PointCloudEncoding point_cloud_encoding_ = PointCloudEncoding::FLOAT32;
+  VoxelGrid voxel_grid_;
+  DepthRayTable depth_ray_table_;
+  DepthRayTable color_ray_table_;
+  int point_cloud_thread_num_ = THREAD_NUM;
+  bool ordered_point_cloud_ = ORDERED_POINTCLOUD;
+  std::mutex point_cloud_filter_mutex_;
+  double point_cloud_min_distance_ = POINT_CLOUD_MIN_DISTANCE;
+  double point_cloud_max_distance_ = POINT_CLOUD_MAX_DISTANCE;
+  DepthFilter point_cloud_filter_;
+  std::shared_ptr<WorkerPool> point_cloud_worker_pool_ = nullptr;
   std::atomic_bool pipeline_started_{false};
   bool enable_point_cloud_ = false;
   bool enable_colored_point_cloud_ = false;
   std::atomic_bool save_point_cloud_{false};
   std::atomic_bool save_colored_point_cloud_{false};
-  boost::optional<OBCameraParam> camera_params_;
+  struct CalibrationEntry {
+    boost::optional<OBCameraParam> param;
+    sensor_msgs::CameraInfo camera_info;
+  };
+  // Must be called with calibration_cache_mutex_ held.
+  CalibrationEntry& findCalibration(const stream_index_pair& stream_index, int width, int height,
+                                    bool aligned);
+  std::mutex calibration_cache_mutex_;
+  std::map<std::tuple<stream_index_pair, int, int, bool>, CalibrationEntry> calibration_cache_;
+  // One per enabled stream, created in setupPublishers().
+  std::map<stream_index_pair, MessagePool<sensor_msgs::CameraInfo>> camera_info_pools_;
   bool is_initialized_ = false;
   bool enable_soft_filter_ = true;
   bool enable_color_auto_exposure_ = true;
@@ -372,7 +595,6 @@ class OBCameraNode {
   OB_DEPTH_PRECISION_LEVEL depth_precision_ = OB_PRECISION_1MM;
   // IMU
 
-  std::map<stream_index_pair, ros::Publisher> imu_publishers_;
   std::map<stream_index_pair, std::string> imu_rate_;
   std::map<stream_index_pair, std::string> imu_range_;
   std::map<stream_index_pair, std::string> imu_qos_;
@@ -380,13 +602,69 @@ class OBCameraNode {
   std::map<stream_index_pair, std::shared_ptr<ob::Sensor>> imu_sensor_;
   double liner_accel_cov_ = 0.0001;
   double angular_vel_cov_ = 0.0001;
-  std::deque<IMUData> imu_history_;
+  int imu_batch_size_ = 0;
+  std::unique_ptr<SPSCRing<IMUData>> accel_ring_;
+  std::unique_ptr<SPSCRing<IMUData>> gyro_ring_;
+  std::atomic<uint64_t> imu_dropped_samples_{0};
+  std::shared_ptr<std::thread> imu_publish_thread_ = nullptr;
+  std::mutex imu_publish_mutex_;
+  std::condition_variable imu_publish_cv_;
+  std::atomic_bool imu_publish_waiting_{false};
+  IMUOutput accel_output_;
+  IMUOutput gyro_output_;
+  IMUOutput united_output_;
+  UniteIMUMethod unite_imu_method_ = UniteIMUMethod::NONE;
+  bool enable_imu_orientation_ = false;
+  double imu_orientation_rate_ = DEFAULT_IMU_ORIENTATION_RATE;
+  double imu_orientation_gain_ = DEFAULT_IMU_ORIENTATION_GAIN;
+  std::unique_ptr<OrientationFilter> orientation_filter_;
+  ros::Publisher imu_orientation_pub_;
+  sensor_msgs::Imu imu_orientation_msg_;
+  double imu_orientation_published_ = -1;  // timestamp in nanoseconds
+  std::mutex imu_united_mutex_;
+  // Pending gyro samples, a ring of imu_history_size_ samples from imu_history_begin_.
+  std::array<IMUData, UNITE_IMU_HISTORY_SIZE> imu_history_;
+  size_t imu_history_begin_ = 0;
+  size_t imu_history_size_ = 0;
   IMUData accel_data_{ACCEL, {0, 0, 0}, -1.0};
+  IMUData prev_accel_data_{ACCEL, {0, 0, 0}, -1.0};
+
+  // Latency of the frame processing stages, published on /diagnostics.
+  double diagnostics_period_ = DIAGNOSTICS_PERIOD;
+  std::unique_ptr<LatencyStats> latency_stats_;
+  std::map<stream_index_pair, int> delivery_latency_stages_;    // system timestamp to callback
+  std::map<stream_index_pair, int> publish_latency_stages_;     // onNewFrameCallback
+  std::map<stream_index_pair, int> end_to_end_latency_stages_;  // system timestamp to published
+  int color_decode_latency_stage_ = -1;
+  int point_cloud_latency_stage_ = -1;
+  ros::Publisher diagnostics_pub_;
+  ros::WallTimer diagnostics_timer_;
+  std::mutex latency_summaries_mutex_;
+  std::vector<LatencyStats::Summary> latency_summaries_;
+
+  // Decoded frame buffers, allocated once per stream.
+  std::string frame_buffer_memory_ = DEFAULT_FRAME_BUFFER_MEMORY;
+  std::unique_ptr<BufferArena> buffer_arena_;
 
   // mjpeg decoder
   std::shared_ptr<JPEGDecoder> mjpeg_decoder_ = nullptr;
+  bool use_libjpeg_turbo_ = true;
+  BufferArena::Buffer rgb_buffer_block_;
   uint8_t* rgb_buffer_ = nullptr;
   bool rgb_is_decoded_ = false;
+  const uint8_t* rgb_data_ = nullptr;
+  int color_decode_thread_num_ = 0;
+  int color_decode_max_in_flight_ = DEFAULT_COLOR_DECODE_MAX_IN_FLIGHT;
+  std::vector<std::unique_ptr<ob::FormatConvertFilter>> color_decode_filters_;
+  std::vector<std::shared_ptr<JPEGDecoder>> color_decode_mjpeg_decoders_;
+  std::unique_ptr<OrderedFrameDecoder> color_decoder_;
+
+  // IR MJPG frames are decoded into these images, backed by arena buffers.
+  std::map<stream_index_pair, BufferArena::Buffer> ir_decode_buffers_;
+  std::map<stream_index_pair, cv::Mat> ir_decoded_images_;
+  std::map<stream_index_pair, bool> ir_is_decoded_;
+  std::map<stream_index_pair, std::shared_ptr<TurboJPEGDecoder>> ir_mjpeg_decoders_;
+  std::shared_ptr<WorkerPool> ir_decode_worker_pool_;
 
   // double infrared
   bool enable_left_ir_ = false;
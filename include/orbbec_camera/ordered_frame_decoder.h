@@ -0,0 +1,87 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "libobsensor/ObSensor.hpp"
+
+namespace orbbec_camera {
+
+// Decodes frame sets on a pool of threads and hands them on in the order they
+// were submitted, from a single output thread. At most max_in_flight frame sets
+// are decoding or waiting for output at a time; further ones are dropped, so
+// that latency stays bounded when decoding cannot keep up. Each in-flight slot
+// owns its output buffer, which keeps its capacity from frame to frame.
+class OrderedFrameDecoder {
+ public:
+  // Decodes frame_set into buffer on worker thread worker, in [0, thread_num).
+  // Returns false if there is nothing to hand on.
+  using DecodeFunc = std::function<bool(int worker, const std::shared_ptr<ob::FrameSet> &frame_set,
+                                        std::vector<uint8_t> &buffer)>;
+  // buffer is null if decoding failed.
+  using OutputFunc =
+      std::function<void(const std::shared_ptr<ob::FrameSet> &frame_set, const uint8_t *buffer)>;
+
+  OrderedFrameDecoder(int thread_num, int max_in_flight, DecodeFunc decode, OutputFunc output);
+
+  OrderedFrameDecoder(const OrderedFrameDecoder &) = delete;
+
+  OrderedFrameDecoder &operator=(const OrderedFrameDecoder &) = delete;
+
+  // Frame sets that were not handed on yet are discarded.
+  ~OrderedFrameDecoder();
+
+  // Returns false if the frame set was dropped because the window is full.
+  bool submit(const std::shared_ptr<ob::FrameSet> &frame_set);
+
+  uint64_t droppedCount() const;
+
+ private:
+  struct Slot {
+    std::shared_ptr<ob::FrameSet> frame_set;
+    std::vector<uint8_t> buffer;
+    bool done = false;
+    bool decoded = false;
+  };
+
+  void decodeLoop(int worker);
+
+  void outputLoop();
+
+  DecodeFunc decode_;
+  OutputFunc output_;
+  std::vector<Slot> slots_;
+  std::vector<std::thread> threads_;
+  mutable std::mutex mutex_;
+  std::condition_variable decode_cv_;
+  std::condition_variable output_cv_;
+  // Sequence numbers, slot i holds the frame set of sequence number s with s % size == i.
+  uint64_t submitted_ = 0;
+  uint64_t next_decode_ = 0;
+  uint64_t next_output_ = 0;
+  uint64_t dropped_ = 0;
+  bool stop_ = false;
+};
+
+}  // namespace orbbec_camera
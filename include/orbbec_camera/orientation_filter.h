@@ -0,0 +1,54 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#pragma once
+
+#include <eigen3/Eigen/Dense>
+
+namespace orbbec_camera {
+
+// Madgwick's gradient descent orientation filter for accelerometer and
+// gyroscope samples. The orientation rotates the sensor frame into a gravity
+// aligned frame with z up. Its yaw starts at zero and drifts with the gyro
+// bias, as there is no magnetometer. Not thread safe.
+class OrientationFilter {
+ public:
+  // gain is the filter's beta, how fast the accelerometer corrects the gyro drift.
+  explicit OrientationFilter(double gain = 0.1) : gain_(gain) {}
+
+  // Keeps the sample to correct the next gyro updates with. Initializes the
+  // orientation from gravity on the first sample.
+  void updateAccel(const Eigen::Vector3d &accel);
+
+  // Integrates a gyro sample in rad/s, timestamp in seconds. Does nothing
+  // before the first accel sample.
+  void updateGyro(const Eigen::Vector3d &gyro, double timestamp);
+
+  void reset();
+
+  bool isInitialized() const { return initialized_; }
+
+  const Eigen::Quaterniond &orientation() const { return orientation_; }
+
+ private:
+  double gain_;
+  bool initialized_ = false;
+  Eigen::Vector3d accel_ = Eigen::Vector3d::Zero();
+  double last_timestamp_ = -1.0;
+  Eigen::Quaterniond orientation_ = Eigen::Quaterniond::Identity();
+};
+
+}  // namespace orbbec_camera
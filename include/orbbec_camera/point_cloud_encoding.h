@@ -0,0 +1,50 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace orbbec_camera {
+
+// Layout of the xyz fields of a published point cloud.
+enum class PointCloudEncoding {
+  FLOAT32,   // float32 meters, 16 bytes per point (12 bytes xyz + padding)
+  INT16_MM,  // int16 millimeters, 8 bytes per point, invalid points are 0
+  FLOAT16,   // IEEE 754 half float meters, 8 bytes per point
+};
+
+// Bytes of a quantized xyz triplet including padding, and the offset of the
+// "rgb" field right after it in a colored quantized cloud.
+const size_t QUANTIZED_POINT_STEP = 8;
+const size_t QUANTIZED_POINT_RGB_OFFSET = 8;
+
+PointCloudEncoding pointCloudEncodingFromString(const std::string &encoding);
+
+// Converts a float to IEEE 754 half precision, rounding to nearest even.
+uint16_t floatToHalf(float value);
+
+// Packs count points of in_step bytes (x, y, z float32 in meters at offset 0)
+// into QUANTIZED_POINT_STEP bytes each at out_step. Millimeters saturate to the
+// int16 range and NaN becomes 0; half floats keep NaN. If colored, the 4 bytes
+// at in_rgb_offset are copied to QUANTIZED_POINT_RGB_OFFSET.
+void quantizePoints(const uint8_t *in, size_t count, size_t in_step, PointCloudEncoding encoding,
+                    uint8_t *out, size_t out_step, bool colored = false,
+                    size_t in_rgb_offset = 16);
+
+}  // namespace orbbec_camera
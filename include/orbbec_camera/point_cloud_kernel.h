@@ -0,0 +1,124 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "libobsensor/ObSensor.hpp"
+#include "worker_pool.h"
+
+namespace orbbec_camera {
+
+// Byte offset of the "rgb" field in a colored cloud, right after the padded xyz.
+const size_t COLORED_POINT_RGB_OFFSET = 16;
+
+// Limits applied while back-projecting a depth frame. The depth range is in raw
+// depth units and the box in meters; both are inclusive. Pixels outside the ROI
+// are never read, a zero roi_width or roi_height extends it to the frame edge.
+struct DepthFilter {
+  float min_depth = 0.0f;
+  float max_depth = std::numeric_limits<float>::max();
+  int roi_x = 0;
+  int roi_y = 0;
+  int roi_width = 0;
+  int roi_height = 0;
+  float box_min[3] = {-std::numeric_limits<float>::infinity(),
+                      -std::numeric_limits<float>::infinity(),
+                      -std::numeric_limits<float>::infinity()};
+  float box_max[3] = {std::numeric_limits<float>::infinity(),
+                      std::numeric_limits<float>::infinity(),
+                      std::numeric_limits<float>::infinity()};
+
+  bool hasBox() const;
+
+  // Clamps the ROI to a width x height frame.
+  void roiBounds(int width, int height, int &x_begin, int &y_begin, int &x_end, int &y_end) const;
+};
+
+// Per-resolution ray lookup table used to back-project depth pixels.
+// The pinhole model is separable, so ray_x only depends on the column
+// ((x - u0) / fx) and ray_y only on the row ((y - v0) / fy).
+class DepthRayTable {
+ public:
+  // Rebuilds the table when the intrinsic or the frame resolution changed.
+  // Returns true if the table was rebuilt.
+  bool update(const OBCameraIntrinsic &intrinsic, int width, int height);
+
+  bool empty() const { return ray_x_.empty(); }
+
+  int width() const { return width_; }
+
+  int height() const { return height_; }
+
+  const float *rayX() const { return ray_x_.data(); }
+
+  const float *rayY() const { return ray_y_.data(); }
+
+ private:
+  OBCameraIntrinsic intrinsic_{};
+  int width_ = 0;
+  int height_ = 0;
+  std::vector<float> ray_x_;
+  std::vector<float> ray_y_;
+};
+
+// Back-projects the pixels [x_begin, x_end) of one depth row into points of
+// point_step bytes (x, y, z float32 in meters at offset 0, then 4 bytes of zero
+// padding). Pixels rejected by filter are skipped, its ROI is ignored.
+// out must have room for (x_end - x_begin) points, point_step must be >= 16.
+// Slots past the returned count may be overwritten, nothing past the
+// (x_end - x_begin) slots is.
+// Returns the number of points written.
+size_t depthRowToPoints(const uint16_t *depth_row, const float *ray_x, float ray_y, int x_begin,
+                        int x_end, float depth_scale, const DepthFilter &filter, uint8_t *out,
+                        size_t point_step);
+
+// Same as depthRowToPoints, additionally packing the color of rgb_row (RGB888)
+// into the "rgb" field at COLORED_POINT_RGB_OFFSET. point_step must be >= 20.
+// Nothing is written past the last point.
+size_t depthRowToColoredPoints(const uint16_t *depth_row, const uint8_t *rgb_row,
+                               const float *ray_x, float ray_y, int x_begin, int x_end,
+                               float depth_scale, const DepthFilter &filter, uint8_t *out,
+                               size_t point_step);
+
+// Counts the points depthRowToPoints would write for the same arguments.
+size_t countValidPoints(const uint16_t *depth_row, const float *ray_x, float ray_y, int x_begin,
+                        int x_end, float depth_scale, const DepthFilter &filter);
+
+// Back-projects the filter ROI of a depth frame of table.width() x
+// table.height() pixels, see depthRowToPoints.
+size_t depthToPoints(const uint16_t *depth, const DepthRayTable &table, float depth_scale,
+                     const DepthFilter &filter, uint8_t *out, size_t point_step);
+
+// Back-projects a depth frame aligned to an RGB888 frame of the same size into
+// colored points. With a pool the rows are split into bands processed in
+// parallel; the point order is the same as a serial pass.
+size_t depthToColoredPoints(const uint16_t *depth, const uint8_t *rgb, const DepthRayTable &table,
+                            float depth_scale, const DepthFilter &filter, uint8_t *out,
+                            size_t point_step, WorkerPool *pool = nullptr);
+
+// Back-projects a depth frame into an organized cloud with one point per pixel
+// of the filter ROI, where rejected pixels are NaN. If rgb is not null the
+// color of each pixel is packed as in depthRowToColoredPoints. Output slots are
+// fixed per pixel, so with a pool all rows are processed in parallel.
+void depthToOrganizedPoints(const uint16_t *depth, const uint8_t *rgb, const DepthRayTable &table,
+                            float depth_scale, const DepthFilter &filter, uint8_t *out,
+                            size_t point_step, WorkerPool *pool = nullptr);
+
+}  // namespace orbbec_camera
@@ -0,0 +1,82 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace orbbec_camera {
+
+// Fixed size lock-free ring passing items from one producer thread to one
+// consumer thread. The capacity is rounded up to a power of two.
+template <typename T>
+class SPSCRing {
+ public:
+  explicit SPSCRing(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    items_.resize(size);
+    mask_ = size - 1;
+  }
+
+  // Producer only. Returns false, dropping item, if the ring is full.
+  bool push(const T &item) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) > mask_) {
+      return false;
+    }
+    items_[tail & mask_] = item;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only. The oldest item, or nullptr if the ring is empty.
+  const T *front() const {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    return &items_[head & mask_];
+  }
+
+  // Consumer only. Removes the item returned by front().
+  void pop() { head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+  bool empty() const {
+    return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+  }
+
+  size_t capacity() const { return items_.size(); }
+
+ private:
+  static const size_t CACHE_LINE_SIZE = 64;
+
+  std::vector<T> items_;
+  size_t mask_ = 0;
+  // The indices only grow, and are kept on separate cache lines.
+  char pad0_[CACHE_LINE_SIZE];
+  std::atomic<size_t> head_{0};
+  char pad1_[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> tail_{0};
+  char pad2_[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+};
+
+}  // namespace orbbec_camera
@@ -0,0 +1,66 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#pragma once
+
+#include <csetjmp>
+#include <cstdio>
+
+#include <jpeglib.h>
+
+#include "jpeg_decoder.h"
+
+namespace orbbec_camera {
+
+// Software MJPEG decoder on top of libjpeg-turbo. The decompressor is created once and reused
+// for every frame, and scanlines are written straight into the caller's buffer. An instance
+// must not be shared between threads.
+class TurboJPEGDecoder : public JPEGDecoder {
+ public:
+  enum class PixelFormat { RGB, BGR, GRAY };
+
+  TurboJPEGDecoder(int width, int height, PixelFormat format = PixelFormat::RGB);
+
+  ~TurboJPEGDecoder() override;
+
+  bool decode(const std::shared_ptr<ob::ColorFrame>& frame, uint8_t* dest) override;
+
+  // Decodes size bytes of JPEG data into dest, whose rows are dest_step bytes apart. The image
+  // must be width x height; with scale_denom 2, 4 or 8 it is downscaled in the DCT domain to
+  // scaledSize(width, scale_denom) x scaledSize(height, scale_denom).
+  bool decode(const uint8_t* data, size_t size, uint8_t* dest, size_t dest_step,
+              PixelFormat format, int scale_denom = 1);
+
+  static int scaledSize(int size, int scale_denom) { return (size + scale_denom - 1) / scale_denom; }
+
+  static int pixelSize(PixelFormat format) { return format == PixelFormat::GRAY ? 1 : 3; }
+
+ private:
+  struct ErrorManager {
+    jpeg_error_mgr pub;
+    jmp_buf jump_buffer;
+  };
+
+  static void onError(j_common_ptr cinfo);
+
+  static void onMessage(j_common_ptr cinfo);
+
+  PixelFormat format_;
+  jpeg_decompress_struct cinfo_;
+  ErrorManager error_manager_;
+};
+
+}  // namespace orbbec_camera
@@ -33,6 +33,7 @@
 #include "orbbec_camera/GetCameraInfo.h"
 #include "orbbec_camera/SetBool.h"
 #include "orbbec_camera/SetInt32.h"
+#include "orbbec_camera/SetPointCloudFilter.h"
 #include "orbbec_camera/SetString.h"
 #include "orbbec_camera/GetCameraParams.h"
 #include "std_srvs/SetBool.h"
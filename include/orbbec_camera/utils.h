@@ -29,6 +29,10 @@ OBFormat OBFormatFromString(const std::string &format);
 
 std::string OBFormatToString(const OBFormat &format);
 
+// The sensor_msgs encoding of color frames of format published as they are, empty for formats
+// that must be decoded first.
+std::string nativeColorEncoding(const OBFormat &format);
+
 std::string ObDeviceTypeToString(const OBDeviceType &type);
 
 sensor_msgs::CameraInfo convertToCameraInfo(OBCameraIntrinsic intrinsic,
@@ -0,0 +1,76 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace orbbec_camera {
+
+enum class VoxelSelection {
+  CENTROID,     // average of all points falling into the voxel
+  FIRST_POINT,  // first point falling into the voxel, no averaging
+};
+
+VoxelSelection voxelSelectionFromString(const std::string &selection);
+
+// Hash-based voxel grid filter. The hash table is kept between frames and only
+// grows when a frame occupies more voxels than it can hold, so steady-state
+// filtering does not allocate.
+class VoxelGrid {
+ public:
+  explicit VoxelGrid(float leaf_size = 0.05f,
+                     VoxelSelection selection = VoxelSelection::CENTROID);
+
+  void setLeafSize(float leaf_size);
+
+  float leafSize() const { return leaf_size_; }
+
+  void setSelection(VoxelSelection selection) { selection_ = selection; }
+
+  VoxelSelection selection() const { return selection_; }
+
+  // Downsamples count points of in_step bytes (x, y, z float32 in meters at
+  // offset 0) into out, writing x, y, z and zero padding at out_step bytes per
+  // point. Non-finite points are skipped. Voxels are written in the order they
+  // are first hit. out must have room for count points.
+  // Returns the number of points written.
+  size_t filter(const uint8_t *in, size_t count, size_t in_step, uint8_t *out, size_t out_step);
+
+ private:
+  struct Voxel {
+    uint64_t key;
+    uint32_t stamp;
+    uint32_t count;
+    float x, y, z;
+  };
+
+  size_t findSlot(uint64_t key) const;
+
+  void grow();
+
+  float leaf_size_;
+  float inv_leaf_size_;
+  VoxelSelection selection_;
+  std::vector<Voxel> table_;
+  std::vector<uint32_t> occupied_;
+  uint32_t stamp_ = 0;
+};
+
+}  // namespace orbbec_camera
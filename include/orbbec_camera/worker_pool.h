@@ -0,0 +1,67 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "constants.h"
+
+namespace orbbec_camera {
+
+// Fixed-size pool of worker threads for data-parallel frame processing.
+// The calling thread takes part in every job, so a pool of N threads runs
+// N + 1 tasks concurrently.
+class WorkerPool {
+ public:
+  explicit WorkerPool(int thread_num = THREAD_NUM);
+
+  WorkerPool(const WorkerPool &) = delete;
+
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  ~WorkerPool();
+
+  // Number of threads a job is spread over, including the calling thread.
+  int concurrency() const { return static_cast<int>(threads_.size()) + 1; }
+
+  // Runs task(i) for every i in [0, count) and returns once all of them are done.
+  void parallelFor(int count, const std::function<void(int)> &task);
+
+ private:
+  void workerLoop();
+
+  void runTasks();
+
+  std::vector<std::thread> threads_;
+  std::mutex job_mutex_;
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  const std::function<void(int)> *task_ = nullptr;
+  int task_count_ = 0;
+  std::atomic<int> next_task_{0};
+  int active_workers_ = 0;
+  uint64_t generation_ = 0;
+  bool stop_ = false;
+};
+
+}  // namespace orbbec_camera
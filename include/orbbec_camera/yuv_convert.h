@@ -0,0 +1,72 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <libobsensor/h/ObTypes.h>
+
+namespace orbbec_camera {
+
+// Whether extractLuma supports frames of format.
+bool hasLumaPlane(OBFormat format);
+
+// Copies the Y plane of a width x height YUYV, UYVY, NV12, NV21 or I420 frame of
+// src_size bytes to dst, whose rows are dst_step bytes apart. Returns false for
+// other formats or a truncated frame.
+bool extractLuma(const uint8_t *src, size_t src_size, OBFormat format, int width, int height,
+                 uint8_t *dst, size_t dst_step);
+
+// Converts YUYV, UYVY, NV12, NV21 and I420 frames to 24-bit RGB or BGR with
+// BT.601 or BT.709 coefficients, for limited (16-235) or full range input.
+// Fixed point, the SIMD paths give exactly the results of the scalar one.
+class YUVConverter {
+ public:
+  enum class Matrix { BT601, BT709 };
+
+  YUVConverter() { setup(Matrix::BT601, false, false); }
+
+  YUVConverter(Matrix matrix, bool full_range, bool bgr) { setup(matrix, full_range, bgr); }
+
+  void setup(Matrix matrix, bool full_range, bool bgr);
+
+  // Converts a width x height frame of src_size bytes into dst, whose rows are
+  // dst_step bytes apart. Width must be even, and height too for the 4:2:0
+  // formats. Returns false for other formats or a truncated frame.
+  bool convert(const uint8_t *src, size_t src_size, OBFormat format, int width, int height,
+               uint8_t *dst, size_t dst_step) const;
+
+  // Fixed point coefficients, applied with 16-bit multiplies keeping the high
+  // half: luma by Y << 8 (unsigned), chroma by (C - 128) << 8. The sums are in
+  // 1/32 units and y_bias includes the range offset and rounding.
+  struct Coefficients {
+    int16_t y;
+    int16_t y_bias;
+    int16_t rv;
+    int16_t gu;
+    int16_t gv;
+    int16_t bu;
+  };
+
+ private:
+  Coefficients coefficients_;
+  bool bgr_ = false;
+};
+
+}  // namespace orbbec_camera
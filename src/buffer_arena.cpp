@@ -0,0 +1,175 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+
+#include "orbbec_camera/buffer_arena.h"
+#include <ros/ros.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+
+namespace orbbec_camera {
+namespace {
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+size_t roundUp(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+}  // namespace
+
+BufferArena::Buffer &BufferArena::Buffer::operator=(Buffer &&other) noexcept {
+  if (this != &other) {
+    reset();
+    arena_ = other.arena_;
+    pool_ = other.pool_;
+    data_ = other.data_;
+    size_ = other.size_;
+    other.arena_ = nullptr;
+    other.data_ = nullptr;
+    other.size_ = 0;
+  }
+  return *this;
+}
+
+void BufferArena::Buffer::reset() {
+  if (arena_ && data_) {
+    arena_->release(pool_, data_);
+  }
+  arena_ = nullptr;
+  data_ = nullptr;
+  size_ = 0;
+}
+
+BufferArena::~BufferArena() {
+  for (const auto &pool : pools_) {
+    for (const auto &block : pool.blocks) {
+      if (block.in_use) {
+        ROS_ERROR_STREAM("Buffer of pool " << pool.name << " is still in use");
+      }
+      munmap(block.data, block.capacity);
+    }
+  }
+}
+
+size_t BufferArena::findPool(const std::string &name) {
+  for (size_t i = 0; i < pools_.size(); i++) {
+    if (pools_[i].name == name) {
+      return i;
+    }
+  }
+  pools_.push_back(Pool{name, {}});
+  return pools_.size() - 1;
+}
+
+bool BufferArena::mapBlock(size_t size, Block &block) {
+  const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  const bool huge_pages = backing_ == Backing::HUGE_PAGES;
+  size_t capacity = roundUp(std::max<size_t>(size, 1), huge_pages ? HUGE_PAGE_SIZE : page_size);
+  // Populated up front, so that the first frames don't take the page faults.
+  const int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE;
+  void *data = MAP_FAILED;
+  if (huge_pages) {
+    data = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+    if (data == MAP_FAILED) {
+      if (!warned_) {
+        ROS_WARN_STREAM("No huge pages available for frame buffers, using transparent huge pages");
+        warned_ = true;
+      }
+      data = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, flags, -1, 0);
+      if (data != MAP_FAILED) {
+        madvise(data, capacity, MADV_HUGEPAGE);
+      }
+    }
+  } else {
+    data = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, flags, -1, 0);
+  }
+  if (data == MAP_FAILED) {
+    ROS_ERROR_STREAM("Failed to map a frame buffer of " << capacity << " bytes");
+    return false;
+  }
+  if (backing_ == Backing::LOCKED && mlock(data, capacity) != 0 && !warned_) {
+    ROS_WARN_STREAM("Failed to lock frame buffers in memory, check RLIMIT_MEMLOCK");
+    warned_ = true;
+  }
+  block.data = static_cast<uint8_t *>(data);
+  block.capacity = capacity;
+  block.in_use = false;
+  stats_.reserved_bytes += capacity;
+  return true;
+}
+
+void BufferArena::reserve(const std::string &pool, size_t size, int count) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto &blocks = pools_[findPool(pool)].blocks;
+  for (int i = 0; i < count; i++) {
+    Block block;
+    if (!mapBlock(size, block)) {
+      return;
+    }
+    blocks.push_back(block);
+  }
+}
+
+BufferArena::Buffer BufferArena::acquire(const std::string &pool, size_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const size_t pool_index = findPool(pool);
+  auto &blocks = pools_[pool_index].blocks;
+  stats_.acquisitions++;
+  // The smallest free block that fits.
+  Block *found = nullptr;
+  for (auto &block : blocks) {
+    if (!block.in_use && block.capacity >= size &&
+        (!found || block.capacity < found->capacity)) {
+      found = &block;
+    }
+  }
+  if (!found) {
+    stats_.misses++;
+    Block block;
+    if (!mapBlock(size, block)) {
+      return Buffer();
+    }
+    blocks.push_back(block);
+    found = &blocks.back();
+  }
+  found->in_use = true;
+  stats_.in_use_bytes += found->capacity;
+  stats_.high_water_bytes = std::max(stats_.high_water_bytes, stats_.in_use_bytes);
+  Buffer buffer;
+  buffer.arena_ = this;
+  buffer.pool_ = pool_index;
+  buffer.data_ = found->data;
+  buffer.size_ = size;
+  return buffer;
+}
+
+void BufferArena::release(size_t pool, uint8_t *data) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto &block : pools_[pool].blocks) {
+    if (block.data == data) {
+      block.in_use = false;
+      stats_.in_use_bytes -= block.capacity;
+      return;
+    }
+  }
+}
+
+BufferArena::Stats BufferArena::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+}  // namespace orbbec_camera
@@ -0,0 +1,207 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+
+#include "orbbec_camera/depth_scale.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace orbbec_camera {
+namespace {
+// Same division as the point cloud kernels, so depth/image_meters and the z of
+// depth/points agree bit for bit.
+constexpr float MM_PER_METER = 1000.0f;
+constexpr int MAX_SHIFT = 15;
+
+inline uint16_t shiftDepth(uint16_t value, int shift) {
+  if (shift >= 0) {
+    return static_cast<uint16_t>(std::min<uint32_t>(static_cast<uint32_t>(value) << shift, 0xffff));
+  }
+  const int n = -shift;
+  const uint32_t half = 1u << (n - 1);
+  const uint32_t quotient = value >> n;
+  const uint32_t remainder = value & ((1u << n) - 1);
+  const bool round_up = remainder > half || (remainder == half && (quotient & 1));
+  return static_cast<uint16_t>(quotient + round_up);
+}
+
+inline uint16_t multiplyDepth(uint16_t value, float scale) {
+  const float scaled = value * scale;
+  if (!(scaled > 0.0f)) {
+    return 0;
+  }
+  return static_cast<uint16_t>(std::nearbyint(std::min(scaled, 65535.0f)));
+}
+
+inline float depthToMeters(uint16_t value, float scale) {
+  return value == 0 ? std::numeric_limits<float>::quiet_NaN() : value * scale / MM_PER_METER;
+}
+
+#if defined(__SSE2__)
+inline __m128i shiftLeft8(__m128i value, __m128i count) {
+  const __m128i shifted = _mm_sll_epi16(value, count);
+  const __m128i fits = _mm_cmpeq_epi16(_mm_srl_epi16(shifted, count), value);
+  return _mm_or_si128(shifted, _mm_andnot_si128(fits, _mm_set1_epi16(-1)));
+}
+
+inline __m128i shiftRight8(__m128i value, __m128i count, __m128i mask, __m128i half) {
+  const __m128i quotient = _mm_srl_epi16(value, count);
+  const __m128i remainder = _mm_and_si128(value, mask);
+  const __m128i odd = _mm_cmpeq_epi16(_mm_and_si128(quotient, _mm_set1_epi16(1)),
+                                      _mm_set1_epi16(1));
+  const __m128i round_up =
+      _mm_or_si128(_mm_cmpgt_epi16(remainder, half),
+                   _mm_and_si128(_mm_cmpeq_epi16(remainder, half), odd));
+  // round_up lanes are -1.
+  return _mm_sub_epi16(quotient, round_up);
+}
+
+inline __m128i roundToU32(__m128 value) {
+  value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(65535.0f));
+  return _mm_cvtps_epi32(value);
+}
+
+// SSE2 has no unsigned saturating 32 to 16-bit pack, bias into the signed range.
+inline __m128i packU32(__m128i lo, __m128i hi) {
+  const __m128i bias = _mm_set1_epi32(32768);
+  const __m128i packed = _mm_packs_epi32(_mm_sub_epi32(lo, bias), _mm_sub_epi32(hi, bias));
+  return _mm_xor_si128(packed, _mm_set1_epi16(static_cast<int16_t>(0x8000)));
+}
+
+inline void storeMeters4(float *meters, __m128 depth, __m128 scale) {
+  const __m128 value = _mm_div_ps(_mm_mul_ps(depth, scale), _mm_set1_ps(MM_PER_METER));
+  const __m128 invalid = _mm_cmpeq_ps(depth, _mm_setzero_ps());
+  const __m128 nan = _mm_set1_ps(std::numeric_limits<float>::quiet_NaN());
+  _mm_storeu_ps(meters, _mm_or_ps(_mm_and_ps(invalid, nan), _mm_andnot_ps(invalid, value)));
+}
+#elif defined(__aarch64__)
+inline uint16x8_t shiftRight8(uint16x8_t value, int16x8_t neg_count, uint16x8_t mask,
+                              uint16x8_t half) {
+  const uint16x8_t quotient = vshlq_u16(value, neg_count);
+  const uint16x8_t remainder = vandq_u16(value, mask);
+  const uint16x8_t odd = vtstq_u16(quotient, vdupq_n_u16(1));
+  const uint16x8_t round_up = vorrq_u16(vcgtq_u16(remainder, half),
+                                        vandq_u16(vceqq_u16(remainder, half), odd));
+  return vsubq_u16(quotient, round_up);
+}
+
+inline void storeMeters4(float *meters, float32x4_t depth, float32x4_t scale) {
+  const float32x4_t value = vdivq_f32(vmulq_f32(depth, scale), vdupq_n_f32(MM_PER_METER));
+  const uint32x4_t invalid = vceqq_f32(depth, vdupq_n_f32(0.0f));
+  const float32x4_t nan = vdupq_n_f32(std::numeric_limits<float>::quiet_NaN());
+  vst1q_f32(meters, vbslq_f32(invalid, nan, value));
+}
+#endif
+}  // namespace
+
+void DepthScaler::setScale(float scale) {
+  if (scale == scale_) {
+    return;
+  }
+  scale_ = scale;
+  shift_ = 0;
+  int exponent = 0;
+  if (scale == 1.0f) {
+    mode_ = Mode::IDENTITY;
+  } else if (std::isfinite(scale) && std::frexp(scale, &exponent) == 0.5f &&
+             std::abs(exponent - 1) <= MAX_SHIFT) {
+    mode_ = Mode::SHIFT;
+    shift_ = exponent - 1;
+  } else {
+    mode_ = Mode::MULTIPLY;
+  }
+}
+
+void DepthScaler::apply(const uint16_t *in, uint16_t *out, float *meters, size_t count) const {
+  if (mode_ == Mode::IDENTITY && !meters) {
+    if (in != out) {
+      memmove(out, in, count * sizeof(uint16_t));
+    }
+    return;
+  }
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128 scale = _mm_set1_ps(scale_);
+  const __m128i count_vec = _mm_cvtsi32_si128(std::abs(shift_));
+  const int n = std::max(-shift_, 1);
+  const __m128i mask = _mm_set1_epi16(static_cast<int16_t>((1 << n) - 1));
+  const __m128i half = _mm_set1_epi16(static_cast<int16_t>(1 << (n - 1)));
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 8 <= count; i += 8) {
+    const __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    const __m128 lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(raw, zero));
+    const __m128 hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(raw, zero));
+    __m128i result = raw;
+    if (mode_ == Mode::SHIFT) {
+      result = shift_ > 0 ? shiftLeft8(raw, count_vec) : shiftRight8(raw, count_vec, mask, half);
+    } else if (mode_ == Mode::MULTIPLY) {
+      result = packU32(roundToU32(_mm_mul_ps(lo, scale)), roundToU32(_mm_mul_ps(hi, scale)));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), result);
+    if (meters) {
+      storeMeters4(meters + i, lo, scale);
+      storeMeters4(meters + i + 4, hi, scale);
+    }
+  }
+#elif defined(__aarch64__)
+  const float32x4_t scale = vdupq_n_f32(scale_);
+  const int16x8_t shift = vdupq_n_s16(static_cast<int16_t>(shift_));
+  const int n = std::max(-shift_, 1);
+  const uint16x8_t mask = vdupq_n_u16(static_cast<uint16_t>((1 << n) - 1));
+  const uint16x8_t half = vdupq_n_u16(static_cast<uint16_t>(1 << (n - 1)));
+  for (; i + 8 <= count; i += 8) {
+    const uint16x8_t raw = vld1q_u16(in + i);
+    const float32x4_t lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(raw)));
+    const float32x4_t hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(raw)));
+    uint16x8_t result = raw;
+    if (mode_ == Mode::SHIFT) {
+      result = shift_ > 0 ? vqshlq_u16(raw, shift) : shiftRight8(raw, shift, mask, half);
+    } else if (mode_ == Mode::MULTIPLY) {
+      // vcvtn rounds to nearest even and saturates negative values to 0.
+      result = vcombine_u16(vqmovn_u32(vcvtnq_u32_f32(vmulq_f32(lo, scale))),
+                            vqmovn_u32(vcvtnq_u32_f32(vmulq_f32(hi, scale))));
+    }
+    vst1q_u16(out + i, result);
+    if (meters) {
+      storeMeters4(meters + i, lo, scale);
+      storeMeters4(meters + i + 4, hi, scale);
+    }
+  }
+#endif
+  for (; i < count; i++) {
+    const uint16_t value = in[i];
+    if (mode_ == Mode::SHIFT) {
+      out[i] = shiftDepth(value, shift_);
+    } else if (mode_ == Mode::MULTIPLY) {
+      out[i] = multiplyDepth(value, scale_);
+    } else {
+      out[i] = value;
+    }
+    if (meters) {
+      meters[i] = depthToMeters(value, scale_);
+    }
+  }
+}
+
+}  // namespace orbbec_camera
@@ -0,0 +1,475 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+// Microbenchmarks of the per-frame processing of the camera node, run on
+// synthetic frames so that no device is needed. Every benchmark reports the
+// time per frame and, through SetBytesProcessed, the throughput over the
+// input frame. Run with --benchmark_filter=<regex> to select benchmarks.
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <opencv2/opencv.hpp>
+#include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/point_cloud2_iterator.h>
+
+#include "libobsensor/ObSensor.hpp"
+#include "orbbec_camera/depth_scale.h"
+#include "orbbec_camera/image_flip.h"
+#include "orbbec_camera/point_cloud_encoding.h"
+#include "orbbec_camera/point_cloud_kernel.h"
+#include "orbbec_camera/utils.h"
+#include "orbbec_camera/voxel_grid.h"
+#include "orbbec_camera/worker_pool.h"
+#include "orbbec_camera/yuv_convert.h"
+#if defined(USE_LIBJPEG_TURBO)
+#include "orbbec_camera/turbo_jpeg_decoder.h"
+#endif
+
+namespace orbbec_camera {
+namespace {
+
+const float DEPTH_SCALE = 1.0f;  // millimeters per depth unit
+const int JPEG_QUALITY = 90;
+
+// Resolutions of the streams the node is typically run with.
+void frameSizes(benchmark::internal::Benchmark *bench) {
+  bench->ArgNames({"width", "height"});
+  bench->Args({640, 480});
+  bench->Args({1280, 800});
+  bench->Args({1920, 1080});
+}
+
+// Color conversion is compared at the usual color resolutions as well.
+void colorFrameSizes(benchmark::internal::Benchmark *bench) {
+  bench->ArgNames({"width", "height"});
+  bench->Args({640, 480});
+  bench->Args({1280, 720});
+  bench->Args({1280, 800});
+  bench->Args({1920, 1080});
+  bench->Args({3840, 2160});
+}
+
+OBCameraIntrinsic syntheticIntrinsic(int width, int height) {
+  OBCameraIntrinsic intrinsic{};
+  intrinsic.fx = 0.8f * static_cast<float>(width);
+  intrinsic.fy = 0.8f * static_cast<float>(width);
+  intrinsic.cx = 0.5f * static_cast<float>(width);
+  intrinsic.cy = 0.5f * static_cast<float>(height);
+  intrinsic.width = static_cast<int16_t>(width);
+  intrinsic.height = static_cast<int16_t>(height);
+  return intrinsic;
+}
+
+// A tilted plane between 0.5 m and 4.5 m with small ripples and about 5% of
+// the pixels invalid, so the kernels see both valid and invalid depth.
+std::shared_ptr<ob::Frame> createDepthFrame(int width, int height) {
+  auto frame = ob::FrameHelper::createFrame(OB_FRAME_DEPTH, OB_FORMAT_Y16, width, height,
+                                            width * sizeof(uint16_t));
+  auto *depth = static_cast<uint16_t *>(frame->data());
+  uint32_t seed = 12345;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      seed = seed * 1664525u + 1013904223u;
+      const bool invalid = (seed >> 24) < 13;
+      const int value = 500 + 4000 * (x + y) / (width + height) + static_cast<int>(seed >> 29);
+      depth[y * width + x] = invalid ? 0 : static_cast<uint16_t>(value);
+    }
+  }
+  return frame;
+}
+
+// Smooth gradients plus texture, which compresses like a camera image rather
+// than a flat color.
+cv::Mat createImage(int width, int height, int type) {
+  cv::Mat image(height, width, type);
+  cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(64));
+  for (int y = 0; y < height; y++) {
+    auto *row = image.ptr<uint8_t>(y);
+    for (int i = 0; i < width * image.channels(); i++) {
+      row[i] = static_cast<uint8_t>(row[i] + (i * 191 / (width * image.channels())) + y % 16);
+    }
+  }
+  return image;
+}
+
+// Returns nullptr if the SDK sized the frame differently from the format.
+std::shared_ptr<ob::Frame> createColorFrame(OBFormat format, int width, int height,
+                                            const cv::Mat &rgb) {
+  const size_t size = format == OB_FORMAT_NV12 ? width * height * 3 / 2 : width * height * 2;
+  // A stride of 0 lets the SDK size the frame from the format, which NV12 needs.
+  auto frame = ob::FrameHelper::createFrame(OB_FRAME_COLOR, format, width, height, 0);
+  if (!frame || frame->dataSize() < size) {
+    return nullptr;
+  }
+  auto *data = static_cast<uint8_t *>(frame->data());
+  // Only the luma matters for the conversion cost, chroma is left neutral.
+  memset(data, 128, size);
+  for (int y = 0; y < height; y++) {
+    const uint8_t *src = rgb.ptr<uint8_t>(y);
+    for (int x = 0; x < width; x++) {
+      uint8_t luma = src[x * 3 + 1];
+      if (format == OB_FORMAT_NV12) {
+        data[y * width + x] = luma;
+      } else {
+        data[(y * width + x) * 2] = luma;
+      }
+    }
+  }
+  return frame;
+}
+
+std::vector<uint8_t> encodeJPEG(const cv::Mat &image) {
+  std::vector<uint8_t> jpeg;
+  cv::imencode(".jpg", image, jpeg, {cv::IMWRITE_JPEG_QUALITY, JPEG_QUALITY});
+  return jpeg;
+}
+
+// Wraps an encoded image in an MJPG frame without copying it, the buffer must
+// outlive the frame.
+std::shared_ptr<ob::Frame> createMJPGFrame(std::vector<uint8_t> &jpeg, int width, int height) {
+  return ob::FrameHelper::createFrameFromBuffer(
+      OB_FORMAT_MJPG, width, height, jpeg.data(), static_cast<uint32_t>(jpeg.size()),
+      [](void *, void *) {}, nullptr);
+}
+
+void setFrameCounters(benchmark::State &state, size_t frame_bytes) {
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * frame_bytes));
+}
+
+// Synthetic depth frame with the matching ray table and an aligned color
+// image, as used by the point cloud publishers.
+struct PointCloudInput {
+  PointCloudInput(int width, int height)
+      : width(width),
+        height(height),
+        depth_frame(createDepthFrame(width, height)),
+        rgb(createImage(width, height, CV_8UC3)) {
+    table.update(syntheticIntrinsic(width, height), width, height);
+  }
+
+  const uint16_t *depth() const { return static_cast<const uint16_t *>(depth_frame->data()); }
+
+  size_t pixelCount() const { return static_cast<size_t>(width) * height; }
+
+  int width;
+  int height;
+  std::shared_ptr<ob::Frame> depth_frame;
+  cv::Mat rgb;
+  DepthRayTable table;
+  DepthFilter filter;
+};
+
+void BM_DepthToPoints(benchmark::State &state) {
+  PointCloudInput input(state.range(0), state.range(1));
+  std::vector<uint8_t> points(input.pixelCount() * COLORED_POINT_RGB_OFFSET);
+  for (auto _ : state) {
+    size_t count = depthToPoints(input.depth(), input.table, DEPTH_SCALE, input.filter,
+                                 points.data(), COLORED_POINT_RGB_OFFSET);
+    benchmark::DoNotOptimize(count);
+  }
+  setFrameCounters(state, input.pixelCount() * sizeof(uint16_t));
+}
+BENCHMARK(BM_DepthToPoints)->Apply(frameSizes);
+
+void BM_DepthToColoredPoints(benchmark::State &state, int thread_num) {
+  PointCloudInput input(state.range(0), state.range(1));
+  std::unique_ptr<WorkerPool> pool;
+  if (thread_num > 1) {
+    pool.reset(new WorkerPool(thread_num));
+  }
+  const size_t point_step = COLORED_POINT_RGB_OFFSET * 2;
+  std::vector<uint8_t> points(input.pixelCount() * point_step);
+  for (auto _ : state) {
+    size_t count = depthToColoredPoints(input.depth(), input.rgb.data, input.table, DEPTH_SCALE,
+                                        input.filter, points.data(), point_step, pool.get());
+    benchmark::DoNotOptimize(count);
+  }
+  setFrameCounters(state, input.pixelCount() * (sizeof(uint16_t) + 3));
+}
+BENCHMARK_CAPTURE(BM_DepthToColoredPoints, serial, 1)->Apply(frameSizes);
+BENCHMARK_CAPTURE(BM_DepthToColoredPoints, pool, THREAD_NUM)->Apply(frameSizes)->UseRealTime();
+
+void BM_DepthToOrganizedPoints(benchmark::State &state) {
+  PointCloudInput input(state.range(0), state.range(1));
+  WorkerPool pool(THREAD_NUM);
+  std::vector<uint8_t> points(input.pixelCount() * COLORED_POINT_RGB_OFFSET);
+  for (auto _ : state) {
+    depthToOrganizedPoints(input.depth(), nullptr, input.table, DEPTH_SCALE, input.filter,
+                           points.data(), COLORED_POINT_RGB_OFFSET, &pool);
+    benchmark::ClobberMemory();
+  }
+  setFrameCounters(state, input.pixelCount() * sizeof(uint16_t));
+}
+BENCHMARK(BM_DepthToOrganizedPoints)->Apply(frameSizes)->UseRealTime();
+
+void BM_QuantizePoints(benchmark::State &state, PointCloudEncoding encoding) {
+  PointCloudInput input(state.range(0), state.range(1));
+  std::vector<uint8_t> points(input.pixelCount() * COLORED_POINT_RGB_OFFSET);
+  size_t count = depthToPoints(input.depth(), input.table, DEPTH_SCALE, input.filter,
+                               points.data(), COLORED_POINT_RGB_OFFSET);
+  std::vector<uint8_t> quantized(count * QUANTIZED_POINT_STEP);
+  for (auto _ : state) {
+    quantizePoints(points.data(), count, COLORED_POINT_RGB_OFFSET, encoding, quantized.data(),
+                   QUANTIZED_POINT_STEP);
+    benchmark::ClobberMemory();
+  }
+  setFrameCounters(state, count * COLORED_POINT_RGB_OFFSET);
+}
+BENCHMARK_CAPTURE(BM_QuantizePoints, int16_mm, PointCloudEncoding::INT16_MM)->Apply(frameSizes);
+BENCHMARK_CAPTURE(BM_QuantizePoints, float16, PointCloudEncoding::FLOAT16)->Apply(frameSizes);
+
+void BM_VoxelGrid(benchmark::State &state, VoxelSelection selection) {
+  PointCloudInput input(state.range(0), state.range(1));
+  std::vector<uint8_t> points(input.pixelCount() * COLORED_POINT_RGB_OFFSET);
+  size_t count = depthToPoints(input.depth(), input.table, DEPTH_SCALE, input.filter,
+                               points.data(), COLORED_POINT_RGB_OFFSET);
+  std::vector<uint8_t> voxels(count * COLORED_POINT_RGB_OFFSET);
+  VoxelGrid voxel_grid(0.05f, selection);
+  for (auto _ : state) {
+    size_t voxel_count = voxel_grid.filter(points.data(), count, COLORED_POINT_RGB_OFFSET,
+                                           voxels.data(), COLORED_POINT_RGB_OFFSET);
+    benchmark::DoNotOptimize(voxel_count);
+  }
+  setFrameCounters(state, count * COLORED_POINT_RGB_OFFSET);
+}
+BENCHMARK_CAPTURE(BM_VoxelGrid, centroid, VoxelSelection::CENTROID)->Apply(frameSizes);
+BENCHMARK_CAPTURE(BM_VoxelGrid, first_point, VoxelSelection::FIRST_POINT)->Apply(frameSizes);
+
+// Scaling of depth/image_raw and depth/image_meters in onNewFrameCallback.
+void BM_DepthScale(benchmark::State &state, float scale, bool meters) {
+  const int width = state.range(0);
+  const int height = state.range(1);
+  auto depth_frame = createDepthFrame(width, height);
+  const auto *depth = static_cast<const uint16_t *>(depth_frame->data());
+  const size_t count = static_cast<size_t>(width) * height;
+  std::vector<uint16_t> scaled(count);
+  std::vector<float> depth_meters(meters ? count : 0);
+  DepthScaler scaler;
+  scaler.setScale(scale);
+  for (auto _ : state) {
+    scaler.apply(depth, scaled.data(), meters ? depth_meters.data() : nullptr, count);
+    benchmark::ClobberMemory();
+  }
+  setFrameCounters(state, count * sizeof(uint16_t));
+}
+BENCHMARK_CAPTURE(BM_DepthScale, shift, 2.0f, false)->Apply(frameSizes);
+BENCHMARK_CAPTURE(BM_DepthScale, multiply, 1.5f, false)->Apply(frameSizes);
+BENCHMARK_CAPTURE(BM_DepthScale, meters, 1.0f, true)->Apply(frameSizes);
+
+// In place flip of published images, one benchmark per pixel size.
+void BM_FlipImage(benchmark::State &state, int pixel_size) {
+  const int width = state.range(0);
+  const int height = state.range(1);
+  const size_t step = static_cast<size_t>(width) * pixel_size;
+  std::vector<uint8_t> image(step * height, 0x5a);
+  for (auto _ : state) {
+    flipImageHorizontal(image.data(), step, image.data(), step, width, height, pixel_size);
+    benchmark::ClobberMemory();
+  }
+  setFrameCounters(state, image.size());
+}
+BENCHMARK_CAPTURE(BM_FlipImage, ir, 1)->Apply(frameSizes);
+BENCHMARK_CAPTURE(BM_FlipImage, depth, 2)->Apply(frameSizes);
+BENCHMARK_CAPTURE(BM_FlipImage, rgb, 3)->Apply(frameSizes);
+
+void BM_YUVConverter(benchmark::State &state, OBFormat format) {
+  const int width = state.range(0);
+  const int height = state.range(1);
+  auto frame = createColorFrame(format, width, height, createImage(width, height, CV_8UC3));
+  if (!frame) {
+    state.SkipWithError("Failed to create the color frame");
+    return;
+  }
+  std::vector<uint8_t> rgb(static_cast<size_t>(width) * height * 3);
+  YUVConverter converter;
+  for (auto _ : state) {
+    bool ok = converter.convert(static_cast<const uint8_t *>(frame->data()), frame->dataSize(),
+                                format, width, height, rgb.data(), width * 3);
+    benchmark::DoNotOptimize(ok);
+  }
+  setFrameCounters(state, frame->dataSize());
+}
+BENCHMARK_CAPTURE(BM_YUVConverter, yuyv, OB_FORMAT_YUYV)->Apply(colorFrameSizes);
+BENCHMARK_CAPTURE(BM_YUVConverter, nv12, OB_FORMAT_NV12)->Apply(colorFrameSizes);
+
+// The SDK converter allocates an output frame per call, as in
+// softwareDecodeColorFrame.
+void BM_FormatConvertFilter(benchmark::State &state, OBFormat format, OBConvertFormat type) {
+  const int width = state.range(0);
+  const int height = state.range(1);
+  const cv::Mat rgb = createImage(width, height, CV_8UC3);
+  std::vector<uint8_t> jpeg;
+  std::shared_ptr<ob::Frame> frame;
+  if (format == OB_FORMAT_MJPG) {
+    jpeg = encodeJPEG(rgb);
+    frame = createMJPGFrame(jpeg, width, height);
+  } else {
+    frame = createColorFrame(format, width, height, rgb);
+  }
+  if (!frame) {
+    state.SkipWithError("Failed to create the color frame");
+    return;
+  }
+  ob::FormatConvertFilter filter;
+  filter.setFormatConvertType(type);
+  for (auto _ : state) {
+    auto converted = filter.process(frame);
+    if (!converted) {
+      state.SkipWithError("FormatConvertFilter returned no frame");
+      break;
+    }
+    benchmark::DoNotOptimize(converted->data());
+  }
+  setFrameCounters(state, frame->dataSize());
+}
+BENCHMARK_CAPTURE(BM_FormatConvertFilter, yuyv, OB_FORMAT_YUYV, FORMAT_YUYV_TO_RGB888)
+    ->Apply(colorFrameSizes);
+BENCHMARK_CAPTURE(BM_FormatConvertFilter, nv12, OB_FORMAT_NV12, FORMAT_NV12_TO_RGB888)
+    ->Apply(colorFrameSizes);
+BENCHMARK_CAPTURE(BM_FormatConvertFilter, mjpg, OB_FORMAT_MJPG, FORMAT_MJPG_TO_RGB888)
+    ->Apply(colorFrameSizes);
+
+void BM_ExtractLuma(benchmark::State &state) {
+  const int width = state.range(0);
+  const int height = state.range(1);
+  auto frame =
+      createColorFrame(OB_FORMAT_YUYV, width, height, createImage(width, height, CV_8UC3));
+  if (!frame) {
+    state.SkipWithError("Failed to create the color frame");
+    return;
+  }
+  std::vector<uint8_t> luma(static_cast<size_t>(width) * height);
+  for (auto _ : state) {
+    bool ok = extractLuma(static_cast<const uint8_t *>(frame->data()), frame->dataSize(),
+                          OB_FORMAT_YUYV, width, height, luma.data(), width);
+    benchmark::DoNotOptimize(ok);
+  }
+  setFrameCounters(state, frame->dataSize());
+}
+BENCHMARK(BM_ExtractLuma)->Apply(frameSizes);
+
+// IR MJPG decoding fallback of decodeIRMJPGFrame, imdecode into a reused image.
+void BM_IRDecodeOpenCV(benchmark::State &state) {
+  const int width = state.range(0);
+  const int height = state.range(1);
+  std::vector<uint8_t> jpeg = encodeJPEG(createImage(width, height, CV_8UC1));
+  auto frame = createMJPGFrame(jpeg, width, height);
+  cv::Mat image(height, width, CV_8UC1);
+  for (auto _ : state) {
+    const cv::Mat mjpg(1, static_cast<int>(frame->dataSize()), CV_8UC1, frame->data());
+    cv::imdecode(mjpg, cv::IMREAD_GRAYSCALE, &image);
+    benchmark::DoNotOptimize(image.data);
+  }
+  setFrameCounters(state, frame->dataSize());
+}
+BENCHMARK(BM_IRDecodeOpenCV)->Apply(frameSizes);
+
+#if defined(USE_LIBJPEG_TURBO)
+void BM_TurboJPEGDecode(benchmark::State &state, bool color) {
+  const int width = state.range(0);
+  const int height = state.range(1);
+  std::vector<uint8_t> jpeg = encodeJPEG(createImage(width, height, color ? CV_8UC3 : CV_8UC1));
+  auto frame = createMJPGFrame(jpeg, width, height);
+  const auto format =
+      color ? TurboJPEGDecoder::PixelFormat::RGB : TurboJPEGDecoder::PixelFormat::GRAY;
+  TurboJPEGDecoder decoder(width, height, format);
+  const size_t step = static_cast<size_t>(width) * TurboJPEGDecoder::pixelSize(format);
+  std::vector<uint8_t> image(step * height);
+  for (auto _ : state) {
+    if (!decoder.decode(static_cast<const uint8_t *>(frame->data()), frame->dataSize(),
+                        image.data(), step, format)) {
+      state.SkipWithError("TurboJPEGDecoder failed to decode the frame");
+      break;
+    }
+  }
+  setFrameCounters(state, frame->dataSize());
+}
+BENCHMARK_CAPTURE(BM_TurboJPEGDecode, color, true)->Apply(frameSizes);
+BENCHMARK_CAPTURE(BM_TurboJPEGDecode, ir, false)->Apply(frameSizes);
+#endif
+
+// PLY writers behind save_point_cloud and the save_images service, writing to
+// /dev/null so that only formatting is measured.
+void BM_SavePointCloudMsgToPly(benchmark::State &state, bool colored) {
+  PointCloudInput input(state.range(0), state.range(1));
+  sensor_msgs::PointCloud2 cloud_msg;
+  sensor_msgs::PointCloud2Modifier modifier(cloud_msg);
+  if (colored) {
+    modifier.setPointCloud2FieldsByString(2, "xyz", "rgb");
+  } else {
+    modifier.setPointCloud2FieldsByString(1, "xyz");
+  }
+  cloud_msg.data.resize(input.pixelCount() * cloud_msg.point_step);
+  size_t count =
+      colored ? depthToColoredPoints(input.depth(), input.rgb.data, input.table, DEPTH_SCALE,
+                                     input.filter, cloud_msg.data.data(), cloud_msg.point_step)
+              : depthToPoints(input.depth(), input.table, DEPTH_SCALE, input.filter,
+                              cloud_msg.data.data(), cloud_msg.point_step);
+  cloud_msg.width = count;
+  cloud_msg.height = 1;
+  cloud_msg.row_step = cloud_msg.width * cloud_msg.point_step;
+  cloud_msg.data.resize(cloud_msg.row_step);
+  for (auto _ : state) {
+    if (colored) {
+      saveRGBPointCloudMsgToPly(cloud_msg, "/dev/null");
+    } else {
+      saveDepthPointCloudMsgToPly(cloud_msg, "/dev/null");
+    }
+  }
+  setFrameCounters(state, cloud_msg.data.size());
+}
+BENCHMARK_CAPTURE(BM_SavePointCloudMsgToPly, depth, false)->Apply(frameSizes);
+BENCHMARK_CAPTURE(BM_SavePointCloudMsgToPly, colored, true)->Apply(frameSizes);
+
+void BM_SavePointsToPly(benchmark::State &state) {
+  PointCloudInput input(state.range(0), state.range(1));
+  auto frame = ob::FrameHelper::createFrame(OB_FRAME_POINTS, OB_FORMAT_POINT, input.width,
+                                            input.height, input.width * sizeof(OBPoint));
+  // The kernels store whole 16 byte points, so they can't write OBPoints directly.
+  std::vector<uint8_t> points(input.pixelCount() * COLORED_POINT_RGB_OFFSET);
+  depthToOrganizedPoints(input.depth(), nullptr, input.table, DEPTH_SCALE, input.filter,
+                         points.data(), COLORED_POINT_RGB_OFFSET);
+  auto *frame_points = static_cast<OBPoint *>(frame->data());
+  for (size_t i = 0; i < input.pixelCount(); i++) {
+    memcpy(&frame_points[i], &points[i * COLORED_POINT_RGB_OFFSET], sizeof(OBPoint));
+  }
+  for (auto _ : state) {
+    savePointsToPly(frame, "/dev/null");
+  }
+  setFrameCounters(state, frame->dataSize());
+}
+BENCHMARK(BM_SavePointsToPly)->Apply(frameSizes);
+
+}  // namespace
+}  // namespace orbbec_camera
+
+int main(int argc, char **argv) {
+  // Frames are created through the SDK, one context for the whole run keeps it
+  // from being set up again for every frame and silences its logging.
+  ob::Context context;
+  context.setLoggerSeverity(OBLogSeverity::OB_LOG_SEVERITY_OFF);
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,198 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+
+#include "orbbec_camera/image_flip.h"
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace orbbec_camera {
+namespace {
+#if defined(__SSE2__)
+inline __m128i reverse32(__m128i value) { return _mm_shuffle_epi32(value, _MM_SHUFFLE(0, 1, 2, 3)); }
+
+inline __m128i reverse16(__m128i value) {
+  value = reverse32(value);
+  value = _mm_shufflelo_epi16(value, _MM_SHUFFLE(2, 3, 0, 1));
+  return _mm_shufflehi_epi16(value, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+inline __m128i reverse8(__m128i value) {
+  value = reverse16(value);
+  return _mm_or_si128(_mm_slli_epi16(value, 8), _mm_srli_epi16(value, 8));
+}
+
+// Byte masks of a 48-byte block of 3-byte pixels selecting the bytes at
+// channel 0, 1 and 2 of their pixel, one set per 16-byte vector.
+struct ChannelMasks {
+  ChannelMasks() {
+    for (int i = 0; i < 3; i++) {
+      uint8_t bytes[3][16];
+      for (int j = 0; j < 16; j++) {
+        for (int channel = 0; channel < 3; channel++) {
+          bytes[channel][j] = (i * 16 + j) % 3 == channel ? 0xff : 0;
+        }
+      }
+      for (int channel = 0; channel < 3; channel++) {
+        mask[channel][i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes[channel]));
+      }
+    }
+  }
+
+  __m128i mask[3][3];
+};
+
+const ChannelMasks CHANNEL_MASKS;
+
+// Swaps channels 0 and 2 of every 3-byte pixel in a 48-byte block v[0..2].
+inline void swapOuterChannels(__m128i v[3]) {
+  __m128i out[3];
+  for (int i = 0; i < 3; i++) {
+    const __m128i prev = i > 0 ? v[i - 1] : _mm_setzero_si128();
+    const __m128i next = i < 2 ? v[i + 1] : _mm_setzero_si128();
+    // Byte j of from_left is byte j - 2 of the block, byte j of from_right is byte j + 2.
+    const __m128i from_left = _mm_or_si128(_mm_slli_si128(v[i], 2), _mm_srli_si128(prev, 14));
+    const __m128i from_right = _mm_or_si128(_mm_srli_si128(v[i], 2), _mm_slli_si128(next, 14));
+    out[i] = _mm_or_si128(_mm_and_si128(v[i], CHANNEL_MASKS.mask[1][i]),
+                          _mm_or_si128(_mm_and_si128(from_right, CHANNEL_MASKS.mask[0][i]),
+                                       _mm_and_si128(from_left, CHANNEL_MASKS.mask[2][i])));
+  }
+  v[0] = out[0];
+  v[1] = out[1];
+  v[2] = out[2];
+}
+#endif
+
+// Reverses the order of the BLOCK pixels at src into dst (distinct buffers).
+template <int kPixelSize>
+struct BlockReverser {
+#if defined(__SSE2__) || defined(__aarch64__)
+  static constexpr int BLOCK = kPixelSize == 3 ? 16 : 16 / kPixelSize;
+#else
+  static constexpr int BLOCK = 1;
+#endif
+
+  static void reverse(const uint8_t *src, uint8_t *dst);
+};
+
+template <int kPixelSize>
+void BlockReverser<kPixelSize>::reverse(const uint8_t *src, uint8_t *dst) {
+#if defined(__SSE2__)
+  if (kPixelSize == 3) {
+    __m128i v[3];
+    for (int i = 0; i < 3; i++) {
+      v[2 - i] = reverse8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 16 * i)));
+    }
+    // The byte reversal also reversed the channels inside every pixel.
+    swapOuterChannels(v);
+    for (int i = 0; i < 3; i++) {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 16 * i), v[i]);
+    }
+    return;
+  }
+  __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+  value = kPixelSize == 1 ? reverse8(value) : kPixelSize == 2 ? reverse16(value) : reverse32(value);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), value);
+#elif defined(__aarch64__)
+  if (kPixelSize == 3) {
+    uint8x16x3_t value = vld3q_u8(src);
+    for (int i = 0; i < 3; i++) {
+      value.val[i] = vrev64q_u8(value.val[i]);
+      value.val[i] = vextq_u8(value.val[i], value.val[i], 8);
+    }
+    vst3q_u8(dst, value);
+    return;
+  }
+  uint8x16_t value = vld1q_u8(src);
+  if (kPixelSize == 1) {
+    value = vrev64q_u8(value);
+  } else if (kPixelSize == 2) {
+    value = vreinterpretq_u8_u16(vrev64q_u16(vreinterpretq_u16_u8(value)));
+  } else {
+    value = vreinterpretq_u8_u32(vrev64q_u32(vreinterpretq_u32_u8(value)));
+  }
+  vst1q_u8(dst, vextq_u8(value, value, 8));
+#else
+  memcpy(dst, src, kPixelSize);
+#endif
+}
+
+// Pixels are swapped pairwise from both ends of the row, each pair being read
+// before either side is written, so src may equal dst.
+template <int kPixelSize>
+void flipRow(const uint8_t *src, uint8_t *dst, int width) {
+  constexpr int BLOCK = BlockReverser<kPixelSize>::BLOCK;
+  constexpr int BLOCK_BYTES = BLOCK * kPixelSize;
+  int left = 0;
+  int right = width;
+  if (BLOCK > 1) {
+    uint8_t left_block[BLOCK_BYTES];
+    uint8_t right_block[BLOCK_BYTES];
+    for (; right - left >= 2 * BLOCK; left += BLOCK, right -= BLOCK) {
+      BlockReverser<kPixelSize>::reverse(src + left * kPixelSize, left_block);
+      BlockReverser<kPixelSize>::reverse(src + (right - BLOCK) * kPixelSize, right_block);
+      memcpy(dst + left * kPixelSize, right_block, BLOCK_BYTES);
+      memcpy(dst + (right - BLOCK) * kPixelSize, left_block, BLOCK_BYTES);
+    }
+  }
+  for (; right - left >= 2; left++, right--) {
+    uint8_t left_pixel[kPixelSize];
+    uint8_t right_pixel[kPixelSize];
+    memcpy(left_pixel, src + left * kPixelSize, kPixelSize);
+    memcpy(right_pixel, src + (right - 1) * kPixelSize, kPixelSize);
+    memcpy(dst + left * kPixelSize, right_pixel, kPixelSize);
+    memcpy(dst + (right - 1) * kPixelSize, left_pixel, kPixelSize);
+  }
+  if (right - left == 1 && src != dst) {
+    memcpy(dst + left * kPixelSize, src + left * kPixelSize, kPixelSize);
+  }
+}
+
+template <int kPixelSize>
+void flipRows(const uint8_t *src, size_t src_step, uint8_t *dst, size_t dst_step, int width,
+              int height) {
+  for (int y = 0; y < height; y++) {
+    flipRow<kPixelSize>(src + y * src_step, dst + y * dst_step, width);
+  }
+}
+}  // namespace
+
+void flipImageHorizontal(const uint8_t *src, size_t src_step, uint8_t *dst, size_t dst_step,
+                         int width, int height, int pixel_size) {
+  switch (pixel_size) {
+    case 1:
+      flipRows<1>(src, src_step, dst, dst_step, width, height);
+      break;
+    case 2:
+      flipRows<2>(src, src_step, dst, dst_step, width, height);
+      break;
+    case 3:
+      flipRows<3>(src, src_step, dst, dst_step, width, height);
+      break;
+    case 4:
+      flipRows<4>(src, src_step, dst, dst_step, width, height);
+      break;
+    default:
+      break;
+  }
+}
+
+}  // namespace orbbec_camera
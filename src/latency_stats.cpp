@@ -0,0 +1,112 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#include "orbbec_camera/latency_stats.h"
+#include <algorithm>
+
+namespace orbbec_camera {
+
+LatencyStats::LatencyStats() : collected_(std::chrono::steady_clock::now()) {}
+
+int LatencyStats::addStage(const std::string &name) {
+  std::unique_ptr<Stage> stage(new Stage());
+  stage->name = name;
+  for (auto &bucket : stage->buckets) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  stages_.push_back(std::move(stage));
+  return static_cast<int>(stages_.size()) - 1;
+}
+
+int LatencyStats::bucketIndex(uint64_t us) {
+  if (us < 4) {
+    return static_cast<int>(us);
+  }
+  const int exponent = 63 - __builtin_clzll(us);
+  const int mantissa = static_cast<int>((us >> (exponent - 2)) & 3);
+  return std::min(exponent * 4 + mantissa, BUCKET_COUNT - 1);
+}
+
+double LatencyStats::bucketValue(int bucket) {
+  if (bucket < 4) {
+    return bucket;
+  }
+  const int exponent = bucket / 4;
+  const int mantissa = bucket % 4;
+  const double lower = static_cast<double>(uint64_t(4 + mantissa) << (exponent - 2));
+  const double width = static_cast<double>(uint64_t(1) << (exponent - 2));
+  return lower + width / 2;
+}
+
+void LatencyStats::record(int stage, std::chrono::nanoseconds latency) {
+  if (stage < 0 || stage >= static_cast<int>(stages_.size())) {
+    return;
+  }
+  const int64_t us = std::max<int64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(latency).count(), 0);
+  auto &stats = *stages_[stage];
+  stats.buckets[bucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+  uint64_t max_us = stats.max_us.load(std::memory_order_relaxed);
+  while (static_cast<uint64_t>(us) > max_us &&
+         !stats.max_us.compare_exchange_weak(max_us, us, std::memory_order_relaxed)) {
+  }
+}
+
+void LatencyStats::recordSince(int stage, uint64_t timestamp_ms) {
+  const auto now = std::chrono::system_clock::now().time_since_epoch();
+  record(stage, std::chrono::duration_cast<std::chrono::nanoseconds>(now) -
+                    std::chrono::milliseconds(timestamp_ms));
+}
+
+std::vector<LatencyStats::Summary> LatencyStats::collect() {
+  const auto now = std::chrono::steady_clock::now();
+  const double elapsed = std::chrono::duration<double>(now - collected_).count();
+  collected_ = now;
+  std::vector<Summary> summaries;
+  summaries.reserve(stages_.size());
+  std::array<uint32_t, BUCKET_COUNT> counts;
+  for (auto &stage : stages_) {
+    Summary summary;
+    summary.name = stage->name;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+      counts[i] = stage->buckets[i].exchange(0, std::memory_order_relaxed);
+      summary.count += counts[i];
+    }
+    summary.max_ms = stage->max_us.exchange(0, std::memory_order_relaxed) / 1000.0;
+    if (summary.count > 0) {
+      summary.rate = elapsed > 0 ? summary.count / elapsed : 0.0;
+      const uint64_t p50_rank = (summary.count + 1) / 2;
+      const uint64_t p99_rank = (summary.count * 99 + 99) / 100;
+      uint64_t rank = 0;
+      for (int i = 0; i < BUCKET_COUNT; i++) {
+        if (rank < p50_rank && rank + counts[i] >= p50_rank) {
+          summary.p50_ms = bucketValue(i) / 1000.0;
+        }
+        if (rank < p99_rank && rank + counts[i] >= p99_rank) {
+          summary.p99_ms = bucketValue(i) / 1000.0;
+        }
+        rank += counts[i];
+      }
+      // The bucket middle can exceed the largest latency recorded.
+      summary.p50_ms = std::min(summary.p50_ms, summary.max_ms);
+      summary.p99_ms = std::min(summary.p99_ms, summary.max_ms);
+    }
+    summaries.push_back(summary);
+  }
+  return summaries;
+}
+
+}  // namespace orbbec_camera
@@ -15,11 +15,17 @@
  *******************************************************************************/
 
 #include "orbbec_camera/ob_camera_node.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
 #if defined(USE_RK_HW_DECODER)
 #include "orbbec_camera/rk_mpp_decoder.h"
 #elif defined(USE_NV_HW_DECODER)
 #include "orbbec_camera/jetson_nv_decoder.h"
 #endif
+#if defined(USE_LIBJPEG_TURBO)
+#include "orbbec_camera/turbo_jpeg_decoder.h"
+#endif
 
 namespace orbbec_camera {
 OBCameraNode::OBCameraNode(ros::NodeHandle& nh, ros::NodeHandle& nh_private,
@@ -46,7 +52,16 @@ void OBCameraNode::init() {
   setupDevices();
   setupProfiles();
   setupCameraInfo();
+  setupLatencyStats();
   setupTopics();
+  if (enable_stream_[ACCEL] || enable_stream_[GYRO]) {
+    accel_ring_.reset(new SPSCRing<IMUData>(IMU_RING_SIZE));
+    gyro_ring_.reset(new SPSCRing<IMUData>(IMU_RING_SIZE));
+    if (enable_imu_orientation_) {
+      orientation_filter_.reset(new OrientationFilter(imu_orientation_gain_));
+    }
+    imu_publish_thread_ = std::make_shared<std::thread>([this]() { imuPublishThread(); });
+  }
   setupCameraCtrlServices();
   setupFrameCallback();
   readDefaultExposure();
@@ -57,9 +72,77 @@ void OBCameraNode::init() {
   mjpeg_decoder_ = std::make_shared<RKMjpegDecoder>(width_[COLOR], height_[COLOR]);
 #elif defined(USE_NV_HW_DECODER)
   mjpeg_decoder_ = std::make_shared<JetsonNvJPEGDecoder>(width_[COLOR], height_[COLOR]);
+#else
+  mjpeg_decoder_ = createSoftwareMJPEGDecoder();
+#endif
+#if defined(USE_LIBJPEG_TURBO)
+  if (enable_color_preview_) {
+    color_preview_decoder_ = std::make_shared<TurboJPEGDecoder>(width_[COLOR], height_[COLOR]);
+  }
+  if (enable_color_mono_) {
+    color_mono_decoder_ = std::make_shared<TurboJPEGDecoder>(
+        width_[COLOR], height_[COLOR], TurboJPEGDecoder::PixelFormat::GRAY);
+  }
 #endif
-  rgb_buffer_ = new uint8_t[width_[COLOR] * height_[COLOR] * 3];
+  auto backing = BufferArena::Backing::DEFAULT;
+  if (frame_buffer_memory_ == "locked") {
+    backing = BufferArena::Backing::LOCKED;
+  } else if (frame_buffer_memory_ == "huge_pages") {
+    backing = BufferArena::Backing::HUGE_PAGES;
+  } else if (frame_buffer_memory_ != "default") {
+    ROS_WARN_STREAM("Unknown frame_buffer_memory " << frame_buffer_memory_ << ", using default");
+  }
+  buffer_arena_.reset(new BufferArena(backing));
+  rgb_buffer_block_ = buffer_arena_->acquire("color_rgb", width_[COLOR] * height_[COLOR] * 3);
+  rgb_buffer_ = rgb_buffer_block_.data();
   rgb_is_decoded_ = false;
+  if (color_decode_thread_num_ > 0 && enable_stream_[COLOR]) {
+#if defined(USE_RK_HW_DECODER) || defined(USE_NV_HW_DECODER)
+    ROS_WARN_STREAM("color_decode_thread_num is ignored with the hardware MJPEG decoder");
+#else
+    for (int i = 0; i < color_decode_thread_num_; i++) {
+      color_decode_filters_.emplace_back(new ob::FormatConvertFilter());
+      color_decode_mjpeg_decoders_.push_back(createSoftwareMJPEGDecoder());
+    }
+    color_decoder_.reset(new OrderedFrameDecoder(
+        color_decode_thread_num_, color_decode_max_in_flight_,
+        [this](int worker, const std::shared_ptr<ob::FrameSet>& frame_set,
+               std::vector<uint8_t>& buffer) {
+          return decodeColorFrameSet(worker, frame_set, buffer);
+        },
+        [this](const std::shared_ptr<ob::FrameSet>& frame_set, const uint8_t* rgb) {
+          onDecodedFrameSet(frame_set, rgb);
+        }));
+#endif
+  }
+  if (point_cloud_thread_num_ > 0) {
+    point_cloud_worker_pool_ = std::make_shared<WorkerPool>(point_cloud_thread_num_);
+  }
+  for (const auto& stream_index : {INFRA0, INFRA1, INFRA2}) {
+    if (!enable_stream_[stream_index] || format_[stream_index] != OB_FORMAT_MJPG) {
+      continue;
+    }
+    auto& buffer = ir_decode_buffers_[stream_index];
+    buffer = buffer_arena_->acquire(stream_name_[stream_index] + "_mjpg",
+                                    width_[stream_index] * height_[stream_index]);
+    if (buffer) {
+      ir_decoded_images_[stream_index] =
+          cv::Mat(height_[stream_index], width_[stream_index], CV_8UC1, buffer.data());
+    } else {
+      ir_decoded_images_[stream_index].create(height_[stream_index], width_[stream_index], CV_8UC1);
+    }
+    ir_is_decoded_[stream_index] = false;
+#if defined(USE_LIBJPEG_TURBO)
+    if (use_libjpeg_turbo_) {
+      ir_mjpeg_decoders_[stream_index] = std::make_shared<TurboJPEGDecoder>(
+          width_[stream_index], height_[stream_index], TurboJPEGDecoder::PixelFormat::GRAY);
+    }
+#endif
+  }
+  if (ir_is_decoded_.size() > 1) {
+    // The calling thread decodes one frame and the worker another.
+    ir_decode_worker_pool_ = std::make_shared<WorkerPool>(1);
+  }
 }
 
 bool OBCameraNode::isInitialized() const { return is_initialized_; }
@@ -68,14 +151,30 @@ OBCameraNode::~OBCameraNode() {
   ROS_INFO_STREAM("OBCameraNode::~OBCameraNode() start");
   std::lock_guard<decltype(device_lock_)> lock(device_lock_);
   is_running_ = false;
+  diagnostics_timer_.stop();
   ROS_INFO_STREAM("OBCameraNode::~OBCameraNode() stop tf thread");
   if (tf_thread_ && tf_thread_->joinable()) {
     tf_thread_->join();
   }
   ROS_INFO_STREAM("OBCameraNode::~OBCameraNode() stop stream");
   stopStreams();
-  ROS_INFO_STREAM("OBCameraNode::~OBCameraNode() delete rgb_buffer");
-  delete[] rgb_buffer_;
+  stopIMU();
+  if (imu_publish_thread_ && imu_publish_thread_->joinable()) {
+    notifyIMUPublisher();
+    imu_publish_thread_->join();
+  }
+  color_decoder_.reset();
+  ROS_INFO_STREAM("OBCameraNode::~OBCameraNode() release frame buffers");
+  ir_decoded_images_.clear();
+  ir_decode_buffers_.clear();
+  rgb_buffer_block_.reset();
+  rgb_buffer_ = nullptr;
+  if (buffer_arena_) {
+    const auto stats = buffer_arena_->stats();
+    ROS_INFO_STREAM("Frame buffers: " << stats.reserved_bytes << " bytes reserved, high water "
+                                      << stats.high_water_bytes << " bytes, " << stats.misses
+                                      << " misses in " << stats.acquisitions << " acquisitions");
+  }
   ROS_INFO_STREAM("OBCameraNode::~OBCameraNode() end");
 }
 
@@ -131,6 +230,102 @@ void OBCameraNode::getParameters() {
   enable_pipeline_ = nh_private_.param<bool>("enable_pipeline", false);
   enable_point_cloud_ = nh_private_.param<bool>("enable_point_cloud", true);
   enable_colored_point_cloud_ = nh_private_.param<bool>("enable_colored_point_cloud", false);
+  enable_depth_meters_ = nh_private_.param<bool>("enable_depth_meters", false);
+  point_cloud_thread_num_ = nh_private_.param<int>("point_cloud_thread_num", THREAD_NUM);
+  color_decode_thread_num_ = nh_private_.param<int>("color_decode_thread_num", 0);
+  color_decode_max_in_flight_ =
+      nh_private_.param<int>("color_decode_max_in_flight", DEFAULT_COLOR_DECODE_MAX_IN_FLIGHT);
+  use_libjpeg_turbo_ = nh_private_.param<bool>("use_libjpeg_turbo", true);
+  frame_buffer_memory_ =
+      nh_private_.param<std::string>("frame_buffer_memory", DEFAULT_FRAME_BUFFER_MEMORY);
+  enable_color_preview_ = nh_private_.param<bool>("enable_color_preview", false);
+  color_preview_scale_ =
+      nh_private_.param<int>("color_preview_scale", DEFAULT_COLOR_PREVIEW_SCALE);
+  if (color_preview_scale_ != 2 && color_preview_scale_ != 4 && color_preview_scale_ != 8) {
+    ROS_WARN_STREAM("color_preview_scale must be 2, 4 or 8, using " << DEFAULT_COLOR_PREVIEW_SCALE);
+    color_preview_scale_ = DEFAULT_COLOR_PREVIEW_SCALE;
+  }
+  enable_color_mono_ = nh_private_.param<bool>("enable_color_mono", false);
+  std::string color_yuv_matrix =
+      nh_private_.param<std::string>("color_yuv_matrix", DEFAULT_COLOR_YUV_MATRIX);
+  bool color_yuv_full_range = nh_private_.param<bool>("color_yuv_full_range", false);
+  if (color_yuv_matrix != "bt601" && color_yuv_matrix != "bt709") {
+    ROS_WARN_STREAM("Unknown color_yuv_matrix " << color_yuv_matrix << ", using "
+                                                << DEFAULT_COLOR_YUV_MATRIX);
+  }
+  yuv_converter_.setup(color_yuv_matrix == "bt709" ? YUVConverter::Matrix::BT709
+                                                   : YUVConverter::Matrix::BT601,
+                       color_yuv_full_range, false);
+  color_output_encoding_ =
+      nh_private_.param<std::string>("color_output_encoding", DEFAULT_COLOR_OUTPUT_ENCODING);
+  if (color_output_encoding_ == "native") {
+    std::string encoding = nativeColorEncoding(format_[COLOR]);
+    if (encoding.empty()) {
+      ROS_WARN_STREAM("Color format " << OBFormatToString(format_[COLOR])
+                                      << " has no native encoding, publishing rgb8");
+    } else {
+      publish_native_color_ = true;
+      encoding_[COLOR] = encoding;
+      if (flip_images_[COLOR]) {
+        ROS_WARN_STREAM("flip_color is ignored with the native color output encoding");
+        flip_images_[COLOR] = false;
+      }
+    }
+  } else if (color_output_encoding_ != "rgb8") {
+    ROS_WARN_STREAM("Unknown color_output_encoding " << color_output_encoding_
+                                                     << ", publishing rgb8");
+  }
+  ordered_point_cloud_ = nh_private_.param<bool>("ordered_point_cloud", ORDERED_POINTCLOUD);
+  double point_cloud_min_distance =
+      nh_private_.param<double>("point_cloud_min_distance", POINT_CLOUD_MIN_DISTANCE);
+  double point_cloud_max_distance =
+      nh_private_.param<double>("point_cloud_max_distance", POINT_CLOUD_MAX_DISTANCE);
+  DepthFilter point_cloud_filter;
+  point_cloud_filter.roi_x = nh_private_.param<int>("point_cloud_roi_x", 0);
+  point_cloud_filter.roi_y = nh_private_.param<int>("point_cloud_roi_y", 0);
+  point_cloud_filter.roi_width = nh_private_.param<int>("point_cloud_roi_width", 0);
+  point_cloud_filter.roi_height = nh_private_.param<int>("point_cloud_roi_height", 0);
+  auto box_min = nh_private_.param<std::vector<double>>("point_cloud_box_min", {});
+  auto box_max = nh_private_.param<std::vector<double>>("point_cloud_box_max", {});
+  if (box_min.size() == 3 && box_max.size() == 3) {
+    for (int i = 0; i < 3; i++) {
+      point_cloud_filter.box_min[i] = static_cast<float>(box_min[i]);
+      point_cloud_filter.box_max[i] = static_cast<float>(box_max[i]);
+    }
+  } else if (!box_min.empty() || !box_max.empty()) {
+    ROS_WARN_STREAM("point_cloud_box_min and point_cloud_box_max must both have 3 values");
+  }
+  std::string filter_error =
+      setPointCloudFilter(point_cloud_min_distance, point_cloud_max_distance, point_cloud_filter);
+  if (!filter_error.empty()) {
+    ROS_WARN_STREAM("Ignoring the point cloud filter parameters: " << filter_error);
+    setPointCloudFilter(POINT_CLOUD_MIN_DISTANCE, POINT_CLOUD_MAX_DISTANCE, DepthFilter());
+  }
+  std::string point_cloud_encoding =
+      nh_private_.param<std::string>("point_cloud_encoding", DEFAULT_POINT_CLOUD_ENCODING);
+  if (point_cloud_encoding != "float32" && point_cloud_encoding != "int16" &&
+      point_cloud_encoding != "int16_mm" && point_cloud_encoding != "float16" &&
+      point_cloud_encoding != "half") {
+    ROS_WARN_STREAM("Unknown point_cloud_encoding " << point_cloud_encoding << ", using "
+                                                    << DEFAULT_POINT_CLOUD_ENCODING);
+  }
+  point_cloud_encoding_ = pointCloudEncodingFromString(point_cloud_encoding);
+  double voxel_leaf_size =
+      nh_private_.param<double>("point_cloud_voxel_leaf_size", DEFAULT_VOXEL_LEAF_SIZE);
+  if (!(voxel_leaf_size > 0.0)) {
+    ROS_WARN_STREAM("point_cloud_voxel_leaf_size must be positive, using "
+                    << DEFAULT_VOXEL_LEAF_SIZE);
+    voxel_leaf_size = DEFAULT_VOXEL_LEAF_SIZE;
+  }
+  voxel_grid_.setLeafSize(static_cast<float>(voxel_leaf_size));
+  std::string voxel_selection =
+      nh_private_.param<std::string>("point_cloud_voxel_selection", DEFAULT_VOXEL_SELECTION);
+  if (voxel_selection != "centroid" && voxel_selection != "first" &&
+      voxel_selection != "first_point") {
+    ROS_WARN_STREAM("Unknown point_cloud_voxel_selection " << voxel_selection << ", using "
+                                                           << DEFAULT_VOXEL_SELECTION);
+  }
+  voxel_grid_.setSelection(voxelSelectionFromString(voxel_selection));
   enable_hardware_d2d_ = nh_private_.param<bool>("enable_hardware_d2d", true);
   depth_work_mode_ = nh_private_.param<std::string>("depth_work_mode", "");
   enable_soft_filter_ = nh_private_.param<bool>("enable_soft_filter", true);
@@ -169,6 +364,36 @@ void OBCameraNode::getParameters() {
         nh_private_.param<std::string>(param_name, default_optical_frame_id);
     depth_aligned_frame_id_[stream_index] = stream_name_[COLOR] + "_optical_frame";
   }
+  auto unite_imu_method =
+      nh_private_.param<std::string>("unite_imu_method", DEFAULT_UNITE_IMU_METHOD);
+  if (unite_imu_method == "copy") {
+    unite_imu_method_ = UniteIMUMethod::COPY;
+  } else if (unite_imu_method == "linear_interpolation") {
+    unite_imu_method_ = UniteIMUMethod::LINEAR_INTERPOLATION;
+  } else if (!unite_imu_method.empty()) {
+    ROS_WARN_STREAM("Unknown unite_imu_method " << unite_imu_method << ", publishing separately");
+  }
+  if (unite_imu_method_ != UniteIMUMethod::NONE &&
+      (!enable_stream_[ACCEL] || !enable_stream_[GYRO])) {
+    ROS_WARN_STREAM("unite_imu_method requires enable_accel and enable_gyro");
+    unite_imu_method_ = UniteIMUMethod::NONE;
+  }
+  imu_batch_size_ = nh_private_.param<int>("imu_batch_size", 0);
+  diagnostics_period_ = nh_private_.param<double>("diagnostics_period", DIAGNOSTICS_PERIOD);
+  enable_imu_orientation_ = nh_private_.param<bool>("enable_imu_orientation", false);
+  imu_orientation_rate_ =
+      nh_private_.param<double>("imu_orientation_rate", DEFAULT_IMU_ORIENTATION_RATE);
+  if (!(imu_orientation_rate_ > 0.0)) {
+    ROS_WARN_STREAM("imu_orientation_rate must be positive, using "
+                    << DEFAULT_IMU_ORIENTATION_RATE);
+    imu_orientation_rate_ = DEFAULT_IMU_ORIENTATION_RATE;
+  }
+  imu_orientation_gain_ =
+      nh_private_.param<double>("imu_orientation_gain", DEFAULT_IMU_ORIENTATION_GAIN);
+  if (enable_imu_orientation_ && (!enable_stream_[ACCEL] || !enable_stream_[GYRO])) {
+    ROS_WARN_STREAM("enable_imu_orientation requires enable_accel and enable_gyro");
+    enable_imu_orientation_ = false;
+  }
 }
 
 void OBCameraNode::startStreams() {
@@ -375,7 +600,7 @@ void OBCameraNode::startStream(const stream_index_pair& stream_index) {
     return;
   }
   ROS_INFO_STREAM("Starting stream " << stream_name_[stream_index] << "...");
-  bool has_subscriber = image_publishers_[stream_index].getNumSubscribers() > 0;
+  bool has_subscriber = hasImageSubscriber(stream_index);
   if (!has_subscriber) {
     ROS_INFO_STREAM("No subscriber for stream " << stream_name_[stream_index] << ", skip it.");
     return;
@@ -411,6 +636,11 @@ void OBCameraNode::stopStream(const stream_index_pair& stream_index) {
 }
 
 void OBCameraNode::publishPointCloud(const std::shared_ptr<ob::FrameSet>& frame_set) {
+  const bool has_subscriber = depth_cloud_pub_.getNumSubscribers() > 0 ||
+                              depth_cloud_downsampled_pub_.getNumSubscribers() > 0 ||
+                              depth_registered_cloud_pub_.getNumSubscribers() > 0;
+  LatencyStats::ScopedTimer timer(latency_stats_.get(),
+                                  has_subscriber ? point_cloud_latency_stage_ : -1);
   try {
     if (depth_registration_ || enable_colored_point_cloud_) {
       if (frame_set->depthFrame() != nullptr && frame_set->colorFrame() != nullptr) {
@@ -430,16 +660,8 @@ void OBCameraNode::publishPointCloud(const std::shared_ptr<ob::FrameSet>& frame_
 }
 
 void OBCameraNode::publishDepthPointCloud(const std::shared_ptr<ob::FrameSet>& frame_set) {
-  if (depth_cloud_pub_.getNumSubscribers() == 0 || !enable_point_cloud_) {
-    return;
-  }
-  if (!camera_params_ && depth_registration_) {
-    camera_params_ = pipeline_->getCameraParam();
-  } else if (!camera_params_) {
-    camera_params_ = getCameraDepthParam();
-  }
-  if (!camera_params_) {
-    ROS_ERROR_STREAM("camera_params_ is null");
+  if (!enable_point_cloud_ || (depth_cloud_pub_.getNumSubscribers() == 0 &&
+                               depth_cloud_downsampled_pub_.getNumSubscribers() == 0)) {
     return;
   }
   auto depth_frame = frame_set->depthFrame();
@@ -449,57 +671,52 @@ void OBCameraNode::publishDepthPointCloud(const std::shared_ptr<ob::FrameSet>& f
   }
   auto width = depth_frame->width();
   auto height = depth_frame->height();
-  float fdx =
-      camera_params_->depthIntrinsic.fx * ((float)(width) / camera_params_->depthIntrinsic.width);
-  float fdy =
-      camera_params_->depthIntrinsic.fy * ((float)(height) / camera_params_->depthIntrinsic.height);
-  fdx = 1 / fdx;
-  fdy = 1 / fdy;
-  float u0 =
-      camera_params_->depthIntrinsic.cx * ((float)(width) / camera_params_->depthIntrinsic.width);
-  float v0 =
-      camera_params_->depthIntrinsic.cy * ((float)(height) / camera_params_->depthIntrinsic.height);
+  auto camera_param = getCalibration(DEPTH, static_cast<int>(width), static_cast<int>(height),
+                                     depth_registration_);
+  if (!camera_param) {
+    ROS_ERROR_STREAM("No depth calibration for " << width << "x" << height);
+    return;
+  }
+  depth_ray_table_.update(camera_param->depthIntrinsic, static_cast<int>(width),
+                          static_cast<int>(height));
 
   const auto* depth_data = (uint16_t*)depth_frame->data();
-  sensor_msgs::PointCloud2Modifier modifier(cloud_msg_);
-  modifier.setPointCloud2FieldsByString(1, "xyz");
-  modifier.resize(width * height);
-  cloud_msg_.width = depth_frame->width();
-  cloud_msg_.height = depth_frame->height();
-  cloud_msg_.row_step = cloud_msg_.width * cloud_msg_.point_step;
-  cloud_msg_.data.resize(cloud_msg_.height * cloud_msg_.row_step);
-  sensor_msgs::PointCloud2Iterator<float> iter_x(cloud_msg_, "x");
-  sensor_msgs::PointCloud2Iterator<float> iter_y(cloud_msg_, "y");
-  sensor_msgs::PointCloud2Iterator<float> iter_z(cloud_msg_, "z");
-  size_t valid_count = 0;
-  const static float MIN_DISTANCE = 20.0;
-  const static float MAX_DISTANCE = 10000.0;
   double depth_scale = depth_frame->getValueScale();
-  const static float min_depth = MIN_DISTANCE / depth_scale;
-  const static float max_depth = MAX_DISTANCE / depth_scale;
-  for (int y = 0; y < height; y++) {
-    for (int x = 0; x < width; x++) {
-      if (depth_data[y * width + x] < min_depth || depth_data[y * width + x] > max_depth) {
-        continue;
-      }
-      float xf = (x - u0) * fdx;
-      float yf = (y - v0) * fdy;
-      float zf = depth_data[y * width + x] * depth_scale;
-      *iter_x = zf * xf / 1000.0;
-      *iter_y = zf * yf / 1000.0;
-      *iter_z = zf / 1000.0;
-      ++iter_x, ++iter_y, ++iter_z;
-      valid_count++;
-    }
-  }
+  const DepthFilter filter = getDepthFilter(depth_scale);
+  int x_begin = 0, y_begin = 0, x_end = 0, y_end = 0;
+  filter.roiBounds(static_cast<int>(width), static_cast<int>(height), x_begin, y_begin, x_end,
+                   y_end);
+  auto cloud_msg = depth_cloud_pool_.acquire();
+  depth_cloud_layout_.apply(*cloud_msg);
+  cloud_msg->width = x_end - x_begin;
+  cloud_msg->height = y_end - y_begin;
+  cloud_msg->row_step = cloud_msg->width * cloud_msg->point_step;
+  cloud_msg->data.resize(cloud_msg->height * cloud_msg->row_step);
   auto timestamp = frameTimeStampToROSTime(depth_frame->systemTimeStamp());
-  cloud_msg_.header.stamp = timestamp;
-  cloud_msg_.header.frame_id = optical_frame_id_[DEPTH];
-  cloud_msg_.is_dense = true;
-  cloud_msg_.width = valid_count;
-  cloud_msg_.height = 1;
-  modifier.resize(valid_count);
-  depth_cloud_pub_.publish(cloud_msg_);
+  cloud_msg->header.stamp = timestamp;
+  cloud_msg->header.frame_id = optical_frame_id_[DEPTH];
+  if (ordered_point_cloud_) {
+    depthToOrganizedPoints(depth_data, nullptr, depth_ray_table_, static_cast<float>(depth_scale),
+                           filter, cloud_msg->data.data(), cloud_msg->point_step,
+                           point_cloud_worker_pool_.get());
+    cloud_msg->is_dense = false;
+  } else {
+    size_t valid_count =
+        depthToPoints(depth_data, depth_ray_table_, static_cast<float>(depth_scale), filter,
+                      cloud_msg->data.data(), cloud_msg->point_step);
+    cloud_msg->is_dense = true;
+    cloud_msg->width = valid_count;
+    cloud_msg->height = 1;
+    cloud_msg->row_step = cloud_msg->width * cloud_msg->point_step;
+    cloud_msg->data.resize(cloud_msg->row_step);
+  }
+  if (depth_cloud_downsampled_pub_.getNumSubscribers() > 0) {
+    publishDownsampledPointCloud(*cloud_msg);
+  }
+  if (depth_cloud_pub_.getNumSubscribers() == 0) {
+    return;
+  }
+  depth_cloud_pub_.publish(encodePointCloud(cloud_msg, false, quantized_cloud_pool_));
   if (save_point_cloud_) {
     save_point_cloud_ = false;
     auto now = std::time(nullptr);
@@ -511,10 +728,81 @@ void OBCameraNode::publishDepthPointCloud(const std::shared_ptr<ob::FrameSet>& f
       boost::filesystem::create_directory(current_path + "/point_cloud");
     }
     ROS_INFO_STREAM("Saving point cloud to " << filename);
-    saveDepthPointCloudMsgToPly(cloud_msg_, filename);
+    saveDepthPointCloudMsgToPly(*cloud_msg, filename);
   }
 }
 
+void OBCameraNode::publishDownsampledPointCloud(const sensor_msgs::PointCloud2& cloud_msg) {
+  auto downsampled_msg = downsampled_cloud_pool_.acquire();
+  depth_cloud_layout_.apply(*downsampled_msg);
+  const size_t point_count = cloud_msg.width * cloud_msg.height;
+  downsampled_msg->data.resize(point_count * downsampled_msg->point_step);
+  size_t voxel_count =
+      voxel_grid_.filter(cloud_msg.data.data(), point_count, cloud_msg.point_step,
+                         downsampled_msg->data.data(), downsampled_msg->point_step);
+  downsampled_msg->header = cloud_msg.header;
+  downsampled_msg->is_dense = true;
+  downsampled_msg->width = voxel_count;
+  downsampled_msg->height = 1;
+  downsampled_msg->row_step = downsampled_msg->width * downsampled_msg->point_step;
+  downsampled_msg->data.resize(downsampled_msg->row_step);
+  depth_cloud_downsampled_pub_.publish(downsampled_msg);
+}
+
+std::string OBCameraNode::setPointCloudFilter(double min_distance, double max_distance,
+                                              DepthFilter filter) {
+  if (min_distance < 0 || min_distance >= max_distance) {
+    return "invalid depth range, expect 0 <= min_distance < max_distance";
+  }
+  if (filter.roi_x < 0 || filter.roi_y < 0 || filter.roi_width < 0 || filter.roi_height < 0) {
+    return "invalid ROI, expect non-negative values";
+  }
+  if (std::equal(filter.box_min, filter.box_min + 3, filter.box_max)) {
+    DepthFilter unbounded;
+    std::copy(unbounded.box_min, unbounded.box_min + 3, filter.box_min);
+    std::copy(unbounded.box_max, unbounded.box_max + 3, filter.box_max);
+  }
+  for (int i = 0; i < 3; i++) {
+    if (filter.box_min[i] > filter.box_max[i]) {
+      return "invalid bounding box, expect box_min <= box_max";
+    }
+  }
+  std::lock_guard<std::mutex> lock(point_cloud_filter_mutex_);
+  point_cloud_min_distance_ = min_distance;
+  point_cloud_max_distance_ = max_distance;
+  point_cloud_filter_ = filter;
+  return "";
+}
+
+DepthFilter OBCameraNode::getDepthFilter(double depth_scale) {
+  std::lock_guard<std::mutex> lock(point_cloud_filter_mutex_);
+  DepthFilter filter = point_cloud_filter_;
+  // Computed per frame so that a depth precision change takes effect immediately.
+  filter.min_depth = static_cast<float>(point_cloud_min_distance_ * 1000.0 / depth_scale);
+  filter.max_depth = static_cast<float>(point_cloud_max_distance_ * 1000.0 / depth_scale);
+  return filter;
+}
+
+sensor_msgs::PointCloud2Ptr OBCameraNode::encodePointCloud(
+    const sensor_msgs::PointCloud2Ptr& cloud_msg, bool colored,
+    MessagePool<sensor_msgs::PointCloud2>& pool) {
+  if (point_cloud_encoding_ == PointCloudEncoding::FLOAT32) {
+    return cloud_msg;
+  }
+  auto quantized_msg = pool.acquire();
+  (colored ? quantized_colored_cloud_layout_ : quantized_cloud_layout_).apply(*quantized_msg);
+  quantized_msg->header = cloud_msg->header;
+  quantized_msg->width = cloud_msg->width;
+  quantized_msg->height = cloud_msg->height;
+  quantized_msg->is_dense = cloud_msg->is_dense;
+  quantized_msg->row_step = quantized_msg->width * quantized_msg->point_step;
+  quantized_msg->data.resize(quantized_msg->height * quantized_msg->row_step);
+  quantizePoints(cloud_msg->data.data(), cloud_msg->width * cloud_msg->height,
+                 cloud_msg->point_step, point_cloud_encoding_, quantized_msg->data.data(),
+                 quantized_msg->point_step, colored, COLORED_POINT_RGB_OFFSET);
+  return quantized_msg;
+}
+
 void OBCameraNode::publishColoredPointCloud(const std::shared_ptr<ob::FrameSet>& frame_set) {
   if (depth_registered_cloud_pub_.getNumSubscribers() == 0 || !enable_colored_point_cloud_) {
     return;
@@ -532,80 +820,53 @@ void OBCameraNode::publishColoredPointCloud(const std::shared_ptr<ob::FrameSet>&
     ROS_ERROR_STREAM("depth frame size is not equal to color frame size");
     return;
   }
-  CHECK_NOTNULL(pipeline_.get());
-  if (!camera_params_) {
-    camera_params_ = pipeline_->getCameraParam();
-  }
-  CHECK(camera_params_);
-  float fdx =
-      camera_params_->rgbIntrinsic.fx * ((float)(color_width) / camera_params_->rgbIntrinsic.width);
-  float fdy = camera_params_->rgbIntrinsic.fy *
-              ((float)(color_height) / camera_params_->rgbIntrinsic.height);
-  fdx = 1 / fdx;
-  fdy = 1 / fdy;
-  float u0 =
-      camera_params_->rgbIntrinsic.cx * ((float)(color_width) / camera_params_->rgbIntrinsic.width);
-  float v0 = camera_params_->rgbIntrinsic.cy *
-             ((float)(color_height) / camera_params_->rgbIntrinsic.height);
+  auto camera_param =
+      getCalibration(COLOR, static_cast<int>(color_width), static_cast<int>(color_height), true);
+  if (!camera_param) {
+    ROS_ERROR_STREAM("No aligned calibration for " << color_width << "x" << color_height);
+    return;
+  }
+  color_ray_table_.update(camera_param->rgbIntrinsic, static_cast<int>(color_width),
+                          static_cast<int>(color_height));
   const auto* depth_data = (uint16_t*)depth_frame->data();
-  const auto* color_data = (uint8_t*)(rgb_buffer_);
-  sensor_msgs::PointCloud2Modifier modifier(cloud_msg_);
-  modifier.setPointCloud2FieldsByString(1, "xyz");
-  cloud_msg_.width = color_frame->width();
-  cloud_msg_.height = color_frame->height();
-  std::string format_str = "rgb";
-  cloud_msg_.point_step = addPointField(cloud_msg_, format_str, 1, sensor_msgs::PointField::FLOAT32,
-                                        static_cast<int>(cloud_msg_.point_step));
-  cloud_msg_.row_step = cloud_msg_.width * cloud_msg_.point_step;
-  cloud_msg_.data.resize(cloud_msg_.height * cloud_msg_.row_step);
-  sensor_msgs::PointCloud2Iterator<float> iter_x(cloud_msg_, "x");
-  sensor_msgs::PointCloud2Iterator<float> iter_y(cloud_msg_, "y");
-  sensor_msgs::PointCloud2Iterator<float> iter_z(cloud_msg_, "z");
-  sensor_msgs::PointCloud2Iterator<uint8_t> iter_r(cloud_msg_, "r");
-  sensor_msgs::PointCloud2Iterator<uint8_t> iter_g(cloud_msg_, "g");
-  sensor_msgs::PointCloud2Iterator<uint8_t> iter_b(cloud_msg_, "b");
-  size_t valid_count = 0;
-  static const float MIN_DISTANCE = 20.0;
-  static const float MAX_DISTANCE = 10000.0;
-  double depth_scale = depth_frame->getValueScale();
-  static float min_depth = MIN_DISTANCE / depth_scale;
-  static float max_depth = MAX_DISTANCE / depth_scale;
-  for (int y = 0; y < color_height; y++) {
-    for (int x = 0; x < color_width; x++) {
-      float depth = depth_data[y * depth_width + x];
-      if (depth < min_depth || depth > max_depth) {
-        continue;
-      }
-      float xf = (x - u0) * fdx;
-      float yf = (y - v0) * fdy;
-      float zf = depth * depth_scale;
-      *iter_x = zf * xf / 1000.0;
-      *iter_y = zf * yf / 1000.0;
-      *iter_z = zf / 1000.0;
-      *iter_r = color_data[(y * color_width + x) * 3];
-      *iter_g = color_data[(y * color_width + x) * 3 + 1];
-      *iter_b = color_data[(y * color_width + x) * 3 + 2];
-      ++iter_x;
-      ++iter_y;
-      ++iter_z;
-      ++iter_r;
-      ++iter_g;
-      ++iter_b;
-      ++valid_count;
-    }
-  }
-
-  if (valid_count == 0) {
+  if (!rgb_is_decoded_) {
     return;
   }
+  const auto* color_data = rgb_data_;
+  double depth_scale = depth_frame->getValueScale();
+  const DepthFilter filter = getDepthFilter(depth_scale);
+  int x_begin = 0, y_begin = 0, x_end = 0, y_end = 0;
+  filter.roiBounds(static_cast<int>(color_width), static_cast<int>(color_height), x_begin, y_begin,
+                   x_end, y_end);
+  auto cloud_msg = colored_cloud_pool_.acquire();
+  colored_cloud_layout_.apply(*cloud_msg);
+  cloud_msg->width = x_end - x_begin;
+  cloud_msg->height = y_end - y_begin;
+  cloud_msg->row_step = cloud_msg->width * cloud_msg->point_step;
+  cloud_msg->data.resize(cloud_msg->height * cloud_msg->row_step);
+  if (ordered_point_cloud_) {
+    depthToOrganizedPoints(depth_data, color_data, color_ray_table_,
+                           static_cast<float>(depth_scale), filter, cloud_msg->data.data(),
+                           cloud_msg->point_step, point_cloud_worker_pool_.get());
+    cloud_msg->is_dense = false;
+  } else {
+    size_t valid_count = depthToColoredPoints(
+        depth_data, color_data, color_ray_table_, static_cast<float>(depth_scale), filter,
+        cloud_msg->data.data(), cloud_msg->point_step, point_cloud_worker_pool_.get());
+    if (valid_count == 0) {
+      return;
+    }
+    cloud_msg->is_dense = true;
+    cloud_msg->width = valid_count;
+    cloud_msg->height = 1;
+    cloud_msg->row_step = cloud_msg->width * cloud_msg->point_step;
+    cloud_msg->data.resize(cloud_msg->row_step);
+  }
   auto timestamp = frameTimeStampToROSTime(depth_frame->systemTimeStamp());
-  cloud_msg_.header.stamp = timestamp;
-  cloud_msg_.header.frame_id = optical_frame_id_[COLOR];
-  cloud_msg_.is_dense = true;
-  cloud_msg_.width = valid_count;
-  cloud_msg_.height = 1;
-  modifier.resize(valid_count);
-  depth_registered_cloud_pub_.publish(cloud_msg_);
+  cloud_msg->header.stamp = timestamp;
+  cloud_msg->header.frame_id = optical_frame_id_[COLOR];
+  depth_registered_cloud_pub_.publish(
+      encodePointCloud(cloud_msg, true, quantized_colored_cloud_pool_));
   if (save_colored_point_cloud_) {
     save_colored_point_cloud_ = false;
     auto now = std::time(nullptr);
@@ -617,7 +878,7 @@ void OBCameraNode::publishColoredPointCloud(const std::shared_ptr<ob::FrameSet>&
       boost::filesystem::create_directory(current_path + "/point_cloud");
     }
     ROS_INFO_STREAM("Saving point cloud to " << filename);
-    saveRGBPointCloudMsgToPly(cloud_msg_, filename);
+    saveRGBPointCloudMsgToPly(*cloud_msg, filename);
   }
 }
 
@@ -635,11 +896,9 @@ void OBCameraNode::setDefaultIMUMessage(sensor_msgs::Imu& imu_msg) {
       angular_vel_cov_, 0.0, 0.0, 0.0, angular_vel_cov_, 0.0, 0.0, 0.0, angular_vel_cov_};
 }
 
-sensor_msgs::Imu OBCameraNode::createUnitIMUMessage(const IMUData& accel_data,
-                                                    const IMUData& gyro_data) {
-  sensor_msgs::Imu imu_msg;
-  ros::Time timestamp = ros::Time::now();
-  imu_msg.header.stamp = timestamp;
+void OBCameraNode::createUnitIMUMessage(const IMUData& accel_data, const IMUData& gyro_data,
+                                        sensor_msgs::Imu& imu_msg) {
+  imu_msg.header.stamp.fromNSec(static_cast<uint64_t>(gyro_data.timestamp_));
   imu_msg.angular_velocity.x = gyro_data.data_.x();
   imu_msg.angular_velocity.y = gyro_data.data_.y();
   imu_msg.angular_velocity.z = gyro_data.data_.z();
@@ -647,41 +906,283 @@ sensor_msgs::Imu OBCameraNode::createUnitIMUMessage(const IMUData& accel_data,
   imu_msg.linear_acceleration.x = accel_data.data_.x();
   imu_msg.linear_acceleration.y = accel_data.data_.y();
   imu_msg.linear_acceleration.z = accel_data.data_.z();
-  return imu_msg;
 }
 
 void OBCameraNode::onNewIMUFrameCallback(const std::shared_ptr<ob::Frame>& frame,
                                          const stream_index_pair& stream_index) {
-  if (!imu_publishers_.count(stream_index)) {
-    ROS_ERROR_STREAM("stream " << stream_name_[stream_index] << " publisher not initialized");
+  const double timestamp = static_cast<double>(frame->systemTimeStamp()) * 1e6;
+  IMUData data;
+  if (frame->type() == OB_FRAME_GYRO) {
+    auto value = frame->as<ob::GyroFrame>()->value();
+    data = IMUData(GYRO, {value.x, value.y, value.z}, timestamp);
+  } else if (frame->type() == OB_FRAME_ACCEL) {
+    auto value = frame->as<ob::AccelFrame>()->value();
+    data = IMUData(ACCEL, {value.x, value.y, value.z}, timestamp);
+  } else {
+    ROS_ERROR("Unsupported IMU frame type");
     return;
   }
-  auto subscriber_count = imu_publishers_[stream_index].getNumSubscribers();
-  if (subscriber_count == 0) {
+  // Each sensor has its own ring, so each ring has a single producer.
+  auto& ring = stream_index == ACCEL ? accel_ring_ : gyro_ring_;
+  if (!ring->push(data)) {
+    imu_dropped_samples_++;
+  }
+  notifyIMUPublisher();
+}
+
+void OBCameraNode::notifyIMUPublisher() {
+  // Skips the mutex while the publisher thread is busy draining the rings.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (imu_publish_waiting_.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> lock(imu_publish_mutex_);
+    imu_publish_cv_.notify_one();
+  }
+}
+
+void OBCameraNode::imuPublishThread() {
+  while (is_running_) {
+    {
+      std::unique_lock<std::mutex> lock(imu_publish_mutex_);
+      // Pairs with the fence in notifyIMUPublisher: either the rings are seen non-empty here or
+      // the producer sees the flag and notifies under the mutex, so no wakeup is lost.
+      imu_publish_waiting_.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      imu_publish_cv_.wait(lock, [this] {
+        return !is_running_ || !accel_ring_->empty() || !gyro_ring_->empty();
+      });
+      imu_publish_waiting_.store(false, std::memory_order_relaxed);
+    }
+    while (true) {
+      const IMUData* accel_data = accel_ring_->front();
+      const IMUData* gyro_data = gyro_ring_->front();
+      if (!accel_data && !gyro_data) {
+        break;
+      }
+      if (accel_data && (!gyro_data || accel_data->timestamp_ <= gyro_data->timestamp_)) {
+        processIMUSample(*accel_data);
+        accel_ring_->pop();
+      } else {
+        processIMUSample(*gyro_data);
+        gyro_ring_->pop();
+      }
+    }
+    const uint64_t dropped = imu_dropped_samples_.exchange(0);
+    if (dropped > 0) {
+      ROS_WARN_STREAM_THROTTLE(1.0,
+                               "Dropped " << dropped << " IMU samples, publishing is too slow");
+    }
+  }
+}
+
+void OBCameraNode::processIMUSample(const IMUData& data) {
+  if (latency_stats_) {
+    latency_stats_->recordSince(latencyStage(end_to_end_latency_stages_, data.stream_),
+                                static_cast<uint64_t>(data.timestamp_ / 1e6));
+  }
+  if (orientation_filter_) {
+    updateIMUOrientation(data);
+  }
+  if (unite_imu_method_ != UniteIMUMethod::NONE) {
+    uniteIMUSample(data);
     return;
   }
-  auto imu_msg = sensor_msgs::Imu();
-  setDefaultIMUMessage(imu_msg);
-  imu_msg.header.frame_id = optical_frame_id_[stream_index];
-  auto timestamp = frameTimeStampToROSTime(frame->systemTimeStamp());
-  imu_msg.header.stamp = timestamp;
-  if (frame->type() == OB_FRAME_GYRO) {
-    auto gyro_frame = frame->as<ob::GyroFrame>();
-    auto data = gyro_frame->value();
-    imu_msg.angular_velocity.x = data.x;
-    imu_msg.angular_velocity.y = data.y;
-    imu_msg.angular_velocity.z = data.z;
-  } else if (frame->type() == OB_FRAME_ACCEL) {
-    auto accel_frame = frame->as<ob::AccelFrame>();
-    auto data = accel_frame->value();
-    imu_msg.linear_acceleration.x = data.x;
-    imu_msg.linear_acceleration.y = data.y;
-    imu_msg.linear_acceleration.z = data.z;
+  auto& output = data.stream_ == ACCEL ? accel_output_ : gyro_output_;
+  output.msg.header.stamp.fromNSec(static_cast<uint64_t>(data.timestamp_));
+  if (data.stream_ == ACCEL) {
+    output.msg.linear_acceleration.x = data.data_.x();
+    output.msg.linear_acceleration.y = data.data_.y();
+    output.msg.linear_acceleration.z = data.data_.z();
   } else {
-    ROS_ERROR("Unsupported IMU frame type");
+    output.msg.angular_velocity.x = data.data_.x();
+    output.msg.angular_velocity.y = data.data_.y();
+    output.msg.angular_velocity.z = data.data_.z();
+  }
+  publishIMU(output);
+}
+
+void OBCameraNode::publishIMU(IMUOutput& output) {
+  if (output.publisher.getNumSubscribers() > 0) {
+    output.publisher.publish(output.msg);
+  }
+  if (imu_batch_size_ <= 0) {
+    return;
+  }
+  if (output.batch_publisher.getNumSubscribers() == 0) {
+    // Drop the partial batch, so that the next subscriber gets no stale samples.
+    output.batch_count = 0;
+    return;
+  }
+  // The samples are preallocated, so batching only copies into them.
+  output.batch.samples[output.batch_count++] = output.msg;
+  if (output.batch_count == output.batch.samples.size()) {
+    output.batch.header = output.msg.header;
+    output.batch_publisher.publish(output.batch);
+    output.batch_count = 0;
+  }
+}
+
+void OBCameraNode::uniteIMUSample(const IMUData& data) {
+  const double timestamp = data.timestamp_;
+  std::lock_guard<std::mutex> lock(imu_united_mutex_);
+  if (data.stream_ == ACCEL) {
+    prev_accel_data_ = accel_data_;
+    accel_data_ = data;
+    // The gyro samples up to this accel sample can be interpolated now.
+    while (imu_history_size_ > 0) {
+      const IMUData& gyro_data = imu_history_[imu_history_begin_];
+      if (gyro_data.timestamp_ > accel_data_.timestamp_) {
+        break;
+      }
+      publishUnitedIMU(interpolateAccel(gyro_data.timestamp_), gyro_data);
+      imu_history_begin_ = (imu_history_begin_ + 1) % imu_history_.size();
+      imu_history_size_--;
+    }
+    return;
+  }
+  if (!accel_data_.isSet()) {
+    return;
+  }
+  if (unite_imu_method_ == UniteIMUMethod::COPY || timestamp <= accel_data_.timestamp_) {
+    publishUnitedIMU(interpolateAccel(timestamp), data);
+    return;
+  }
+  if (imu_history_size_ == imu_history_.size()) {
+    // The accel stream stalled, publish the oldest sample with the last accel sample.
+    ROS_WARN_STREAM_THROTTLE(1.0, "No accel sample to interpolate the gyro samples with");
+    publishUnitedIMU(accel_data_, imu_history_[imu_history_begin_]);
+    imu_history_begin_ = (imu_history_begin_ + 1) % imu_history_.size();
+    imu_history_size_--;
+  }
+  imu_history_[(imu_history_begin_ + imu_history_size_) % imu_history_.size()] = data;
+  imu_history_size_++;
+}
+
+void OBCameraNode::updateIMUOrientation(const IMUData& data) {
+  if (data.stream_ == ACCEL) {
+    orientation_filter_->updateAccel(data.data_);
+    imu_orientation_msg_.linear_acceleration.x = data.data_.x();
+    imu_orientation_msg_.linear_acceleration.y = data.data_.y();
+    imu_orientation_msg_.linear_acceleration.z = data.data_.z();
     return;
   }
-  imu_publishers_[stream_index].publish(imu_msg);
+  orientation_filter_->updateGyro(data.data_, data.timestamp_ * 1e-9);
+  imu_orientation_msg_.angular_velocity.x = data.data_.x();
+  imu_orientation_msg_.angular_velocity.y = data.data_.y();
+  imu_orientation_msg_.angular_velocity.z = data.data_.z();
+  if (!orientation_filter_->isInitialized() ||
+      data.timestamp_ - imu_orientation_published_ < 1e9 / imu_orientation_rate_ ||
+      imu_orientation_pub_.getNumSubscribers() == 0) {
+    return;
+  }
+  imu_orientation_published_ = data.timestamp_;
+  const auto& orientation = orientation_filter_->orientation();
+  imu_orientation_msg_.header.stamp.fromNSec(static_cast<uint64_t>(data.timestamp_));
+  imu_orientation_msg_.orientation.x = orientation.x();
+  imu_orientation_msg_.orientation.y = orientation.y();
+  imu_orientation_msg_.orientation.z = orientation.z();
+  imu_orientation_msg_.orientation.w = orientation.w();
+  imu_orientation_pub_.publish(imu_orientation_msg_);
+}
+
+OBCameraNode::IMUData OBCameraNode::interpolateAccel(double timestamp) const {
+  if (unite_imu_method_ != UniteIMUMethod::LINEAR_INTERPOLATION || !prev_accel_data_.isSet() ||
+      accel_data_.timestamp_ <= prev_accel_data_.timestamp_) {
+    return accel_data_;
+  }
+  double ratio = (timestamp - prev_accel_data_.timestamp_) /
+                 (accel_data_.timestamp_ - prev_accel_data_.timestamp_);
+  ratio = std::min(std::max(ratio, 0.0), 1.0);
+  return IMUData(ACCEL,
+                 prev_accel_data_.data_ + (accel_data_.data_ - prev_accel_data_.data_) * ratio,
+                 timestamp);
+}
+
+void OBCameraNode::publishUnitedIMU(const IMUData& accel_data, const IMUData& gyro_data) {
+  createUnitIMUMessage(accel_data, gyro_data, united_output_.msg);
+  publishIMU(united_output_);
+}
+
+void OBCameraNode::resetUnitedIMU() {
+  std::lock_guard<std::mutex> lock(imu_united_mutex_);
+  imu_history_begin_ = 0;
+  imu_history_size_ = 0;
+  accel_data_ = IMUData(ACCEL, {0, 0, 0}, -1.0);
+  prev_accel_data_ = accel_data_;
+}
+
+void OBCameraNode::publishDiagnostics() {
+  auto summaries = latency_stats_->collect();
+  diagnostic_msgs::DiagnosticArray diagnostics;
+  diagnostics.header.stamp = ros::Time::now();
+  const std::string hardware_id = device_info_->serialNumber();
+  auto add_value = [](diagnostic_msgs::DiagnosticStatus& status, const std::string& key,
+                      const std::string& value) {
+    diagnostic_msgs::KeyValue key_value;
+    key_value.key = key;
+    key_value.value = value;
+    status.values.push_back(key_value);
+  };
+  for (const auto& summary : summaries) {
+    diagnostic_msgs::DiagnosticStatus status;
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.name = camera_name_ + ": " + summary.name;
+    status.hardware_id = hardware_id;
+    std::ostringstream message;
+    message << std::fixed << std::setprecision(2) << "p50 " << summary.p50_ms << " ms, p99 "
+            << summary.p99_ms << " ms, max " << summary.max_ms << " ms, " << std::setprecision(1)
+            << summary.rate << " Hz";
+    status.message = message.str();
+    add_value(status, "count", std::to_string(summary.count));
+    add_value(status, "rate_hz", std::to_string(summary.rate));
+    add_value(status, "p50_ms", std::to_string(summary.p50_ms));
+    add_value(status, "p99_ms", std::to_string(summary.p99_ms));
+    add_value(status, "max_ms", std::to_string(summary.max_ms));
+    diagnostics.status.push_back(status);
+  }
+  if (buffer_arena_) {
+    const auto stats = buffer_arena_->stats();
+    diagnostic_msgs::DiagnosticStatus status;
+    status.level = stats.misses > 0 ? diagnostic_msgs::DiagnosticStatus::WARN
+                                    : diagnostic_msgs::DiagnosticStatus::OK;
+    status.name = camera_name_ + ": frame buffers";
+    status.hardware_id = hardware_id;
+    status.message = std::to_string(stats.high_water_bytes) + " of " +
+                     std::to_string(stats.reserved_bytes) + " bytes used at most";
+    add_value(status, "reserved_bytes", std::to_string(stats.reserved_bytes));
+    add_value(status, "in_use_bytes", std::to_string(stats.in_use_bytes));
+    add_value(status, "high_water_bytes", std::to_string(stats.high_water_bytes));
+    add_value(status, "misses", std::to_string(stats.misses));
+    diagnostics.status.push_back(status);
+  }
+  diagnostics_pub_.publish(diagnostics);
+  std::lock_guard<std::mutex> lock(latency_summaries_mutex_);
+  latency_summaries_ = std::move(summaries);
+}
+
+bool OBCameraNode::hasColorSubscriber() {
+  // Without the decode threads, YUV frames are converted straight into the image message.
+  bool has_subscriber = !publish_native_color_ &&
+                        (color_decoder_ || !hasLumaPlane(format_[COLOR])) &&
+                        image_publishers_[COLOR].getNumSubscribers() > 0;
+  if (enable_colored_point_cloud_ && depth_registered_cloud_pub_.getNumSubscribers() > 0) {
+    has_subscriber = true;
+  }
+  if (color_preview_pub_.getNumSubscribers() > 0 && !canDecodeColorPreview()) {
+    has_subscriber = true;
+  }
+  if (color_mono_pub_.getNumSubscribers() > 0 && !canDecodeColorMono()) {
+    has_subscriber = true;
+  }
+  return has_subscriber;
+}
+
+bool OBCameraNode::canDecodeColorPreview() {
+  return color_preview_decoder_ && format_[COLOR] == OB_FORMAT_MJPG;
+}
+
+bool OBCameraNode::canDecodeColorMono() {
+  return hasLumaPlane(format_[COLOR]) ||
+         (color_mono_decoder_ && format_[COLOR] == OB_FORMAT_MJPG);
 }
 
 bool OBCameraNode::decodeColorFrameToBuffer(const std::shared_ptr<ob::Frame>& frame,
@@ -689,34 +1190,25 @@ bool OBCameraNode::decodeColorFrameToBuffer(const std::shared_ptr<ob::Frame>& fr
   if (!rgb_buffer_) {
     return false;
   }
-  bool has_subscriber = image_publishers_[COLOR].getNumSubscribers() > 0;
-  if (enable_colored_point_cloud_ && depth_registered_cloud_pub_.getNumSubscribers() > 0) {
-    has_subscriber = true;
-  }
-  if (!has_subscriber) {
+  if (!hasColorSubscriber()) {
     return false;
   }
   bool is_decoded = false;
   if (!frame) {
     return false;
   }
-#if defined(USE_RK_HW_DECODER) || defined(USE_NV_HW_DECODER)
-  if (frame && frame->format() != OB_FORMAT_RGB888) {
-    if (frame->format() == OB_FORMAT_MJPG && mjpeg_decoder_) {
-      CHECK_NOTNULL(mjpeg_decoder_.get());
-      CHECK_NOTNULL(rgb_buffer_);
-      auto video_frame = frame->as<ob::ColorFrame>();
-      bool ret = mjpeg_decoder_->decode(video_frame, rgb_buffer_);
-      if (!ret) {
-        ROS_ERROR_STREAM("Decode frame failed");
-        is_decoded = false;
-
-      } else {
-        is_decoded = true;
-      }
+  LatencyStats::ScopedTimer timer(latency_stats_.get(), color_decode_latency_stage_);
+  if (hasLumaPlane(frame->format())) {
+    auto video_frame = frame->as<ob::VideoFrame>();
+    is_decoded = convertYUVFrame(video_frame, dest, video_frame->width() * 3);
+  }
+  if (frame->format() == OB_FORMAT_MJPG && mjpeg_decoder_) {
+    auto video_frame = frame->as<ob::ColorFrame>();
+    is_decoded = mjpeg_decoder_->decode(video_frame, dest);
+    if (!is_decoded) {
+      ROS_ERROR_STREAM("Decode frame failed");
     }
   }
-#endif
   if (!is_decoded) {
     auto video_frame = softwareDecodeColorFrame(frame);
     if (!video_frame) {
@@ -730,33 +1222,114 @@ bool OBCameraNode::decodeColorFrameToBuffer(const std::shared_ptr<ob::Frame>& fr
   return true;
 }
 
-std::shared_ptr<ob::Frame> OBCameraNode::decodeIRMJPGFrame(const std::shared_ptr<ob::Frame> &frame) {
-  if (frame->format() == OB_FORMAT_MJPEG &&
-      (frame->type() == OB_FRAME_IR || frame->type() == OB_FRAME_IR_LEFT ||
-       frame->type() == OB_FRAME_IR_RIGHT)) {
-    auto video_frame = frame->as<ob::IRFrame>();
-
-    cv::Mat mjpgMat(1, video_frame->dataSize(), CV_8UC1, video_frame->data());
-    cv::Mat irRawMat = cv::imdecode(mjpgMat, cv::IMREAD_GRAYSCALE);
-
-    std::shared_ptr<ob::Frame> irFrame = ob::FrameHelper::createFrame(
-        video_frame->type(), video_frame->format(), video_frame->width(), video_frame->height(), 0);
+bool OBCameraNode::convertYUVFrame(const std::shared_ptr<ob::VideoFrame>& frame, uint8_t* dest,
+                                   size_t dest_step) {
+  if (!yuv_converter_.convert(static_cast<const uint8_t*>(frame->data()), frame->dataSize(),
+                              frame->format(), static_cast<int>(frame->width()),
+                              static_cast<int>(frame->height()), dest, dest_step)) {
+    ROS_ERROR_STREAM_THROTTLE(1.0, "Convert " << OBFormatToString(frame->format())
+                                              << " frame failed");
+    return false;
+  }
+  return true;
+}
 
-    uint32_t buffer_size = irRawMat.rows * irRawMat.cols * irRawMat.channels();
+bool OBCameraNode::decodeIRMJPGFrame(const std::shared_ptr<ob::VideoFrame>& frame,
+                                     const stream_index_pair& stream_index) {
+  auto it = ir_decoded_images_.find(stream_index);
+  if (it == ir_decoded_images_.end()) {
+    return false;
+  }
+  cv::Mat& image = it->second;
+  const auto* data = static_cast<const uint8_t*>(frame->data());
+  const int width = static_cast<int>(frame->width());
+  const int height = static_cast<int>(frame->height());
+#if defined(USE_LIBJPEG_TURBO)
+  auto decoder = ir_mjpeg_decoders_.find(stream_index);
+  if (decoder != ir_mjpeg_decoders_.end() && image.cols == width && image.rows == height &&
+      decoder->second->decode(data, frame->dataSize(), image.data, image.step,
+                              TurboJPEGDecoder::PixelFormat::GRAY)) {
+    return true;
+  }
+#endif
+  // imdecode reuses image when the decoded size and type match it.
+  const cv::Mat mjpg(1, static_cast<int>(frame->dataSize()), CV_8UC1, const_cast<uint8_t*>(data));
+  cv::imdecode(mjpg, cv::IMREAD_GRAYSCALE, &image);
+  if (image.cols != width || image.rows != height) {
+    ROS_ERROR_STREAM_THROTTLE(1.0, "Failed to decode IR MJPG frame of type " << frame->type());
+    return false;
+  }
+  return true;
+}
 
-    if(buffer_size > irFrame->dataSize()) {
-      ROS_ERROR_STREAM("Insufficient buffer size allocation,failed to decode ir mjpg frame!");
-      return nullptr;
+void OBCameraNode::decodeIRMJPGFrames(const std::shared_ptr<ob::FrameSet>& frame_set) {
+  struct Jobs {
+    stream_index_pair streams[3];
+    std::shared_ptr<ob::VideoFrame> frames[3];
+    int count = 0;
+  } jobs;
+  for (auto& item : ir_is_decoded_) {
+    const stream_index_pair& stream_index = item.first;
+    item.second = false;
+    if (jobs.count == 3 || !hasImageSubscriber(stream_index)) {
+      continue;
+    }
+    auto frame = frame_set->getFrame(STREAM_TYPE_TO_FRAME_TYPE.at(stream_index.first));
+    if (frame == nullptr || frame->format() != OB_FORMAT_MJPG) {
+      continue;
+    }
+    jobs.streams[jobs.count] = stream_index;
+    jobs.frames[jobs.count] = frame->as<ob::VideoFrame>();
+    jobs.count++;
+  }
+  auto task = [this, &jobs](int i) {
+    // Only mapped values of existing keys are written, one per task.
+    ir_is_decoded_.at(jobs.streams[i]) = decodeIRMJPGFrame(jobs.frames[i], jobs.streams[i]);
+  };
+  if (jobs.count > 1 && ir_decode_worker_pool_) {
+    ir_decode_worker_pool_->parallelFor(jobs.count, task);
+  } else {
+    for (int i = 0; i < jobs.count; i++) {
+      task(i);
     }
-
-    memcpy(irFrame->data(), irRawMat.data, buffer_size);
-    ob::FrameHelper::setFrameDeviceTimestamp(irFrame, video_frame->timeStamp());
-    ob::FrameHelper::setFrameDeviceTimestampUs(irFrame, video_frame->timeStampUs());
-    ob::FrameHelper::setFrameSystemTimestamp(irFrame, video_frame->systemTimeStamp());
-    return irFrame;
   }
+}
 
-  return nullptr;
+bool OBCameraNode::decodeColorFrameSet(int worker, const std::shared_ptr<ob::FrameSet>& frame_set,
+                                       std::vector<uint8_t>& buffer) {
+  auto frame = frame_set->colorFrame();
+  if (!frame || !hasColorSubscriber()) {
+    return false;
+  }
+  LatencyStats::ScopedTimer timer(latency_stats_.get(), color_decode_latency_stage_);
+  try {
+    if (hasLumaPlane(frame->format())) {
+      buffer.resize(static_cast<size_t>(frame->width()) * frame->height() * 3);
+      if (convertYUVFrame(frame, buffer.data(), frame->width() * 3)) {
+        return true;
+      }
+    }
+    const auto& mjpeg_decoder = color_decode_mjpeg_decoders_[worker];
+    if (frame->format() == OB_FORMAT_MJPG && mjpeg_decoder) {
+      auto color_frame = frame->as<ob::ColorFrame>();
+      buffer.resize(static_cast<size_t>(color_frame->width()) * color_frame->height() * 3);
+      if (mjpeg_decoder->decode(color_frame, buffer.data())) {
+        return true;
+      }
+      ROS_ERROR_STREAM("Decode frame failed");
+    }
+    auto video_frame = softwareDecodeColorFrame(frame, *color_decode_filters_[worker]);
+    if (!video_frame) {
+      ROS_ERROR_STREAM("Decode frame failed");
+      return false;
+    }
+    buffer.resize(video_frame->dataSize());
+    memcpy(buffer.data(), video_frame->data(), video_frame->dataSize());
+  } catch (const ob::Error& e) {
+    ROS_ERROR_STREAM("decodeColorFrameSet error: " << e.getMessage());
+    return false;
+  }
+  return true;
 }
 
 void OBCameraNode::onNewFrameSetCallback(const std::shared_ptr<ob::FrameSet>& frame_set) {
@@ -767,26 +1340,25 @@ void OBCameraNode::onNewFrameSetCallback(const std::shared_ptr<ob::FrameSet>& fr
   if (frame_set == nullptr) {
     return;
   }
-  try {
-    rgb_is_decoded_ = decodeColorFrameToBuffer(frame_set->colorFrame(), rgb_buffer_);
-    publishPointCloud(frame_set);
-    for (const auto& stream_index : IMAGE_STREAMS) {
-      if (enable_stream_[stream_index]) {
-        auto frame_type = STREAM_TYPE_TO_FRAME_TYPE.at(stream_index.first);
-        auto frame = frame_set->getFrame(frame_type);
-        if (frame == nullptr) {
-          ROS_DEBUG_STREAM("frame type " << frame_type << " is null");
-          continue;
-        }
-
-        std::shared_ptr<ob::Frame> irFrame = decodeIRMJPGFrame(frame);
-        if(irFrame) {
-          onNewFrameCallback(irFrame, stream_index);
-        } else {
-          onNewFrameCallback(frame, stream_index);
-        }
+  if (latency_stats_) {
+    for (const auto& item : delivery_latency_stages_) {
+      auto frame = frame_set->getFrame(STREAM_TYPE_TO_FRAME_TYPE.at(item.first.first));
+      if (frame) {
+        latency_stats_->recordSince(item.second, frame->systemTimeStamp());
       }
     }
+  }
+  if (color_decoder_) {
+    // Every frame set goes through the decoder, so that they are all published in order.
+    if (!color_decoder_->submit(frame_set)) {
+      ROS_WARN_STREAM_THROTTLE(1.0, "Color decoding is falling behind, dropped "
+                                        << color_decoder_->droppedCount() << " frame sets");
+    }
+    return;
+  }
+  try {
+    rgb_is_decoded_ = decodeColorFrameToBuffer(frame_set->colorFrame(), rgb_buffer_);
+    publishFrameSet(frame_set, rgb_buffer_);
   } catch (const ob::Error& e) {
     ROS_ERROR_STREAM("onNewFrameSetCallback error: " << e.getMessage());
   } catch (const std::exception& e) {
@@ -796,16 +1368,249 @@ void OBCameraNode::onNewFrameSetCallback(const std::shared_ptr<ob::FrameSet>& fr
   }
 }
 
+void OBCameraNode::onDecodedFrameSet(const std::shared_ptr<ob::FrameSet>& frame_set,
+                                     const uint8_t* rgb) {
+  if (!is_running_) {
+    return;
+  }
+  try {
+    rgb_is_decoded_ = rgb != nullptr;
+    publishFrameSet(frame_set, rgb);
+  } catch (const ob::Error& e) {
+    ROS_ERROR_STREAM("onDecodedFrameSet error: " << e.getMessage());
+  } catch (const std::exception& e) {
+    ROS_ERROR_STREAM("onDecodedFrameSet error: " << e.what());
+  } catch (...) {
+    ROS_ERROR_STREAM("onDecodedFrameSet error: unknown error");
+  }
+}
+
+void OBCameraNode::publishFrameSet(const std::shared_ptr<ob::FrameSet>& frame_set,
+                                   const uint8_t* rgb) {
+  rgb_data_ = rgb;
+  publishPointCloud(frame_set);
+  if (color_preview_pub_.getNumSubscribers() > 0) {
+    publishColorPreview(frame_set->colorFrame());
+  }
+  if (color_mono_pub_.getNumSubscribers() > 0) {
+    publishColorMono(frame_set->colorFrame());
+  }
+  if (color_compressed_pub_.getNumSubscribers() > 0) {
+    publishColorCompressed(frame_set->colorFrame());
+  }
+  if (!ir_is_decoded_.empty()) {
+    decodeIRMJPGFrames(frame_set);
+  }
+  for (const auto& stream_index : IMAGE_STREAMS) {
+    if (enable_stream_[stream_index]) {
+      auto frame_type = STREAM_TYPE_TO_FRAME_TYPE.at(stream_index.first);
+      auto frame = frame_set->getFrame(frame_type);
+      if (frame == nullptr) {
+        ROS_DEBUG_STREAM("frame type " << frame_type << " is null");
+        continue;
+      }
+      onNewFrameCallback(frame, stream_index);
+    }
+  }
+}
+
+void OBCameraNode::publishColorPreview(const std::shared_ptr<ob::ColorFrame>& frame) {
+  if (!frame) {
+    return;
+  }
+  const int scale = color_preview_scale_;
+  const int full_width = static_cast<int>(frame->width());
+  const int full_height = static_cast<int>(frame->height());
+  const int width = (full_width + scale - 1) / scale;
+  const int height = (full_height + scale - 1) / scale;
+  // The preview is always decoded, encoding_[COLOR] may be a native YUV encoding. BGR frames
+  // are passed through undecoded.
+  const std::string& encoding = frame->format() == OB_FORMAT_BGR
+                                    ? sensor_msgs::image_encodings::BGR8
+                                    : sensor_msgs::image_encodings::RGB8;
+  auto image_msg = acquireColorImage(color_preview_pool_, frame, width, height, encoding, 3);
+  bool is_decoded = false;
+#if defined(USE_LIBJPEG_TURBO)
+  if (color_preview_decoder_ && frame->format() == OB_FORMAT_MJPG && isValidJPEG(frame)) {
+    // The IDCT produces the reduced resolution directly, at a fraction of a full decode.
+    is_decoded = color_preview_decoder_->decode(
+        static_cast<const uint8_t*>(frame->data()), frame->dataSize(), image_msg->data.data(),
+        image_msg->step, TurboJPEGDecoder::PixelFormat::RGB, scale);
+  }
+#endif
+  if (!is_decoded) {
+    if (!rgb_is_decoded_ || !rgb_data_) {
+      ROS_ERROR_STREAM_THROTTLE(1.0, "Color preview frame is not decoded");
+      return;
+    }
+    const cv::Mat src_image(full_height, full_width, CV_8UC3, const_cast<uint8_t*>(rgb_data_));
+    cv::Mat image(height, width, CV_8UC3, image_msg->data.data(), image_msg->step);
+    cv::resize(src_image, image, image.size(), 0, 0, cv::INTER_AREA);
+  }
+  if (flip_images_[COLOR]) {
+    flipImageHorizontal(image_msg->data.data(), image_msg->step, image_msg->data.data(),
+                        image_msg->step, width, height, 3);
+  }
+  color_preview_pub_.publish(image_msg);
+}
+
+void OBCameraNode::publishColorMono(const std::shared_ptr<ob::ColorFrame>& frame) {
+  if (!frame) {
+    return;
+  }
+  const int width = static_cast<int>(frame->width());
+  const int height = static_cast<int>(frame->height());
+  auto image_msg = acquireColorImage(color_mono_pool_, frame, width, height,
+                                     sensor_msgs::image_encodings::MONO8, 1);
+  const auto* data = static_cast<const uint8_t*>(frame->data());
+  // Neither path upsamples chroma or converts colors.
+  bool is_decoded = extractLuma(data, frame->dataSize(), frame->format(), width, height,
+                                image_msg->data.data(), image_msg->step);
+#if defined(USE_LIBJPEG_TURBO)
+  if (!is_decoded && color_mono_decoder_ && frame->format() == OB_FORMAT_MJPG &&
+      isValidJPEG(frame)) {
+    is_decoded = color_mono_decoder_->decode(data, frame->dataSize(), image_msg->data.data(),
+                                             image_msg->step, TurboJPEGDecoder::PixelFormat::GRAY);
+  }
+#endif
+  if (!is_decoded) {
+    if (!rgb_is_decoded_ || !rgb_data_) {
+      ROS_ERROR_STREAM_THROTTLE(1.0, "Color mono frame is not decoded");
+      return;
+    }
+    const cv::Mat src_image(height, width, CV_8UC3, const_cast<uint8_t*>(rgb_data_));
+    cv::Mat image(height, width, CV_8UC1, image_msg->data.data(), image_msg->step);
+    cv::cvtColor(src_image, image, cv::COLOR_RGB2GRAY);
+  }
+  if (flip_images_[COLOR]) {
+    flipImageHorizontal(image_msg->data.data(), image_msg->step, image_msg->data.data(),
+                        image_msg->step, width, height, 1);
+  }
+  color_mono_pub_.publish(image_msg);
+}
+
+void OBCameraNode::publishColorCompressed(const std::shared_ptr<ob::ColorFrame>& frame) {
+  if (!frame || frame->format() != OB_FORMAT_MJPG) {
+    return;
+  }
+  if (!isValidJPEG(frame)) {
+    ROS_ERROR_STREAM_THROTTLE(1.0, "Invalid JPEG");
+    return;
+  }
+  const auto* data = static_cast<const uint8_t*>(frame->data());
+  size_t data_size = frame->dataSize();
+  // The device pads frames with zeros after the EOI marker.
+  while (data_size > 0 && data[data_size - 1] == 0) {
+    data_size--;
+  }
+  auto compressed_msg = color_compressed_pool_.acquire();
+  compressed_msg->header.stamp = frameTimeStampToROSTime(frame->systemTimeStamp());
+  compressed_msg->header.frame_id =
+      depth_registration_ ? depth_aligned_frame_id_[COLOR] : optical_frame_id_[COLOR];
+  compressed_msg->format = "jpeg";
+  compressed_msg->data.assign(data, data + data_size);
+  color_compressed_pub_.publish(compressed_msg);
+}
+
+void OBCameraNode::publishNativeColorImage(const std::shared_ptr<ob::VideoFrame>& frame,
+                                           const ros::Time& timestamp,
+                                           const std::string& frame_id) {
+  const int width = static_cast<int>(frame->width());
+  const int height = static_cast<int>(frame->height());
+  const OBFormat format = frame->format();
+  const bool planar = format == OB_FORMAT_NV21;
+  int pixel_size = 2;
+  if (planar) {
+    pixel_size = 1;
+  } else if (format == OB_FORMAT_RGB888 || format == OB_FORMAT_BGR) {
+    pixel_size = 3;
+  }
+  auto image_msg = image_pools_.at(COLOR).acquire();
+  image_msg->header.stamp = timestamp;
+  image_msg->header.frame_id = frame_id;
+  image_msg->width = width;
+  // The 4:2:0 chroma plane follows the Y plane as height / 2 more rows, so that
+  // data.size() == step * height holds.
+  image_msg->height = planar ? height * 3 / 2 : height;
+  image_msg->encoding = encoding_[COLOR];
+  image_msg->is_bigendian = false;
+  image_msg->step = width * pixel_size;
+  const size_t size = static_cast<size_t>(image_msg->step) * image_msg->height;
+  if (frame->dataSize() < size) {
+    ROS_ERROR_STREAM("Color frame has " << frame->dataSize() << " bytes, expected " << size);
+    return;
+  }
+  const auto* data = static_cast<const uint8_t*>(frame->data());
+  image_msg->data.assign(data, data + size);
+  image_publishers_[COLOR].publish(image_msg);
+  if (save_images_[COLOR]) {
+    // imwrite takes BGR, native images are only converted for saving.
+    uint8_t* msg_data = image_msg->data.data();
+    cv::Mat bgr;
+    switch (format) {
+      case OB_FORMAT_NV21:
+        cv::cvtColor(cv::Mat(image_msg->height, width, CV_8UC1, msg_data), bgr,
+                     cv::COLOR_YUV2BGR_NV21);
+        break;
+      case OB_FORMAT_UYVY:
+        cv::cvtColor(cv::Mat(height, width, CV_8UC2, msg_data), bgr, cv::COLOR_YUV2BGR_UYVY);
+        break;
+      case OB_FORMAT_RGB888:
+        cv::cvtColor(cv::Mat(height, width, CV_8UC3, msg_data), bgr, cv::COLOR_RGB2BGR);
+        break;
+      case OB_FORMAT_BGR:
+        bgr = cv::Mat(height, width, CV_8UC3, msg_data);
+        break;
+      default:  // YUYV and YUY2
+        cv::cvtColor(cv::Mat(height, width, CV_8UC2, msg_data), bgr, cv::COLOR_YUV2BGR_YUYV);
+        break;
+    }
+    saveImageToFile(COLOR, bgr, image_msg);
+  }
+}
+
+sensor_msgs::ImagePtr OBCameraNode::acquireColorImage(MessagePool<sensor_msgs::Image>& pool,
+                                                      const std::shared_ptr<ob::ColorFrame>& frame,
+                                                      int width, int height,
+                                                      const std::string& encoding,
+                                                      int pixel_size) {
+  auto image_msg = pool.acquire();
+  image_msg->header.stamp = frameTimeStampToROSTime(frame->systemTimeStamp());
+  image_msg->header.frame_id =
+      depth_registration_ ? depth_aligned_frame_id_[COLOR] : optical_frame_id_[COLOR];
+  image_msg->width = width;
+  image_msg->height = height;
+  image_msg->encoding = encoding;
+  image_msg->is_bigendian = false;
+  image_msg->step = width * pixel_size;
+  image_msg->data.resize(static_cast<size_t>(image_msg->step) * height);
+  return image_msg;
+}
+
+std::shared_ptr<JPEGDecoder> OBCameraNode::createSoftwareMJPEGDecoder() {
+#if defined(USE_LIBJPEG_TURBO)
+  if (use_libjpeg_turbo_) {
+    return std::make_shared<TurboJPEGDecoder>(width_[COLOR], height_[COLOR]);
+  }
+#endif
+  return nullptr;
+}
+
 std::shared_ptr<ob::Frame> OBCameraNode::softwareDecodeColorFrame(
     const std::shared_ptr<ob::Frame>& frame) {
+  return softwareDecodeColorFrame(frame, format_convert_filter_);
+}
+
+std::shared_ptr<ob::Frame> OBCameraNode::softwareDecodeColorFrame(
+    const std::shared_ptr<ob::Frame>& frame, ob::FormatConvertFilter& filter) {
   if (frame->format() == OB_FORMAT_RGB || frame->format() == OB_FORMAT_BGR) {
     return frame;
   }
-  if (!setupFormatConvertType(frame->format())) {
+  if (!setupFormatConvertType(frame->format(), filter)) {
     ROS_ERROR_STREAM("Unsupported color format: " << frame->format());
     return nullptr;
   }
-  auto covert_frame = format_convert_filter_.process(frame);
+  auto covert_frame = filter.process(frame);
   if (covert_frame == nullptr) {
     ROS_ERROR_STREAM("Format " << frame->format() << " convert to RGB888 failed");
     return nullptr;
@@ -818,13 +1623,15 @@ void OBCameraNode::onNewFrameCallback(const std::shared_ptr<ob::Frame>& frame,
   if (frame == nullptr) {
     return;
   }
-  bool has_subscriber = image_publishers_[stream_index].getNumSubscribers() > 0;
+  bool has_subscriber = hasImageSubscriber(stream_index);
   if (camera_info_publishers_[stream_index].getNumSubscribers() > 0) {
     has_subscriber = true;
   }
   if (!has_subscriber) {
     return;
   }
+  LatencyStats::ScopedTimer timer(latency_stats_.get(),
+                                  latencyStage(publish_latency_stages_, stream_index));
   std::shared_ptr<ob::VideoFrame> video_frame;
   if (frame->type() == OB_FRAME_COLOR) {
     video_frame = frame->as<ob::ColorFrame>();
@@ -845,79 +1652,160 @@ void OBCameraNode::onNewFrameCallback(const std::shared_ptr<ob::Frame>& frame,
   int height = static_cast<int>(video_frame->height());
 
   auto timestamp = frameTimeStampToROSTime(video_frame->systemTimeStamp());
-  if (!camera_params_ && depth_registration_) {
-    camera_params_ = pipeline_->getCameraParam();
-  } else if (!camera_params_ && stream_index == COLOR) {
-    camera_params_ = getCameraColorParam();
-  } else if (!camera_params_ && (stream_index == DEPTH || stream_index == INFRA0)) {
-    camera_params_ = getCameraDepthParam();
-  }
-  std::string frame_id =
+  const std::string& frame_id =
       depth_registration_ ? depth_aligned_frame_id_[stream_index] : optical_frame_id_[stream_index];
-  if (camera_params_) {
-    auto& intrinsic =
-        stream_index == COLOR ? camera_params_->rgbIntrinsic : camera_params_->depthIntrinsic;
-    auto& distortion =
-        stream_index == COLOR ? camera_params_->rgbDistortion : camera_params_->depthDistortion;
-
-    auto camera_info = convertToCameraInfo(intrinsic, distortion, width);
-    CHECK(camera_info_publishers_.count(stream_index) > 0);
-    auto camera_info_publisher = camera_info_publishers_[stream_index];
-    camera_info.width = width;
-    camera_info.height = height;
-    camera_info.header.stamp = timestamp;
-    camera_info.header.frame_id = frame_id;
-    camera_info_publisher.publish(camera_info);
+  CHECK(camera_info_publishers_.count(stream_index) > 0);
+  auto& camera_info_publisher = camera_info_publishers_[stream_index];
+  if (camera_info_publisher.getNumSubscribers() > 0) {
+    auto camera_info = camera_info_pools_.at(stream_index).acquire();
+    if (getCameraInfo(stream_index, width, height, depth_registration_, *camera_info)) {
+      camera_info->header.stamp = timestamp;
+      camera_info->header.frame_id = frame_id;
+      camera_info_publisher.publish(camera_info);
+    }
   }
   CHECK(image_publishers_.count(stream_index));
-  if (image_publishers_[stream_index].getNumSubscribers() == 0) {
+  const bool depth16 = stream_index == DEPTH && image_format_[stream_index] == CV_16UC1;
+  const bool publish_meters = depth16 && depth_meters_pub_.getNumSubscribers() > 0;
+  if (image_publishers_[stream_index].getNumSubscribers() == 0 && !publish_meters) {
     return;
   }
-  auto& image = images_[stream_index];
-  if (image.empty() || image.cols != width || image.rows != height) {
-    image.create(height, width, image_format_[stream_index]);
+  if (frame->type() == OB_FRAME_COLOR && publish_native_color_) {
+    publishNativeColorImage(video_frame, timestamp, frame_id);
+    if (latency_stats_) {
+      latency_stats_->recordSince(latencyStage(end_to_end_latency_stages_, stream_index),
+                                  video_frame->systemTimeStamp());
+    }
+    return;
   }
-  if (frame->type() == OB_FRAME_COLOR && !rgb_is_decoded_) {
+  // YUV color frames that were not decoded for other consumers are converted into the message.
+  const bool convert_yuv = frame->type() == OB_FRAME_COLOR && !rgb_is_decoded_ &&
+                           hasLumaPlane(video_frame->format());
+  if (frame->type() == OB_FRAME_COLOR && !rgb_is_decoded_ && !convert_yuv) {
     ROS_ERROR_STREAM("frame is not decoded");
     return;
   }
-  if (frame->type() == OB_FRAME_COLOR) {
-    memcpy(image.data, rgb_buffer_, width * height * 3);
-  } else {
-    memcpy(image.data, video_frame->data(), video_frame->dataSize());
-  }
-
-  if (stream_index == DEPTH) {
-    auto depth_scale = video_frame->as<ob::DepthFrame>()->getValueScale();
-    image = image * depth_scale;
+  const bool ir_mjpg =
+      ir_is_decoded_.count(stream_index) > 0 && video_frame->format() == OB_FORMAT_MJPG;
+  if (ir_mjpg) {
+    // Frames of the per stream callbacks were not decoded with a frame set.
+    if (!ir_is_decoded_[stream_index] && !decodeIRMJPGFrame(video_frame, stream_index)) {
+      return;
+    }
+    ir_is_decoded_[stream_index] = false;
   }
-  auto image_publisher = image_publishers_[stream_index];
-  auto image_msg =
-      cv_bridge::CvImage(std_msgs::Header(), encoding_[stream_index], image).toImageMsg();
-  CHECK_NOTNULL(image_msg.get());
+  const uint8_t* src_data = static_cast<const uint8_t*>(video_frame->data());
+  size_t src_size = video_frame->dataSize();
+  if (frame->type() == OB_FRAME_COLOR) {
+    src_data = convert_yuv ? src_data : rgb_data_;
+    src_size = static_cast<size_t>(width) * height * 3;
+  } else if (ir_mjpg) {
+    const cv::Mat& decoded = ir_decoded_images_[stream_index];
+    src_data = decoded.data;
+    src_size = decoded.total() * decoded.elemSize();
+  }
+  // Every path below copies the frame into the pooled message exactly once.
+  auto image_msg = image_pools_.at(stream_index).acquire();
   image_msg->header.stamp = timestamp;
+  image_msg->header.frame_id = frame_id;
+  image_msg->width = width;
+  image_msg->height = height;
+  image_msg->encoding = encoding_[stream_index];
   image_msg->is_bigendian = false;
   image_msg->step = width * unit_step_size_[stream_index];
-  image_msg->header.frame_id = frame_id;
-
-  if (!flip_images_[stream_index]) {
-    image_publisher.publish(image_msg);
+  image_msg->data.resize(static_cast<size_t>(image_msg->step) * height);
+  if (src_size < image_msg->data.size()) {
+    ROS_ERROR_STREAM("Frame of stream " << stream_name_[stream_index] << " has " << src_size
+                                        << " bytes, expected " << image_msg->data.size());
+    return;
+  }
+  cv::Mat image(height, width, image_format_[stream_index], image_msg->data.data(),
+                image_msg->step);
+  const cv::Mat src_image(height, width, image_format_[stream_index],
+                          const_cast<uint8_t*>(src_data), image_msg->step);
+  double depth_scale = 1.0;
+  if (stream_index == DEPTH) {
+    depth_scale = video_frame->as<ob::DepthFrame>()->getValueScale();
+  }
+  sensor_msgs::ImagePtr meters_msg;
+  cv::Mat meters_image;
+  if (publish_meters) {
+    meters_msg = depth_meters_pool_.acquire();
+    meters_msg->header = image_msg->header;
+    meters_msg->width = width;
+    meters_msg->height = height;
+    meters_msg->encoding = sensor_msgs::image_encodings::TYPE_32FC1;
+    meters_msg->is_bigendian = false;
+    meters_msg->step = width * sizeof(float);
+    meters_msg->data.resize(static_cast<size_t>(meters_msg->step) * height);
+    meters_image =
+        cv::Mat(height, width, CV_32FC1, meters_msg->data.data(), meters_msg->step);
+  }
+  if (depth16) {
+    depth_scaler_.setScale(static_cast<float>(depth_scale));
+  }
+  const bool flip = flip_images_[stream_index];
+  const int pixel_size = unit_step_size_[stream_index];
+  if (depth16 && (!depth_scaler_.isIdentity() || publish_meters)) {
+    // Row by row, so that the in-place flip runs on rows that are still in cache.
+    for (int y = 0; y < height; y++) {
+      float* meters_row = publish_meters ? meters_image.ptr<float>(y) : nullptr;
+      depth_scaler_.apply(src_image.ptr<uint16_t>(y), image.ptr<uint16_t>(y), meters_row,
+                          width);
+      if (flip) {
+        flipImageHorizontal(image.ptr(y), image.step, image.ptr(y), image.step, width, 1,
+                            pixel_size);
+        if (meters_row) {
+          flipImageHorizontal(meters_image.ptr(y), meters_image.step, meters_image.ptr(y),
+                              meters_image.step, width, 1, sizeof(float));
+        }
+      }
+    }
+  } else if (!depth16 && depth_scale != 1.0) {
+    src_image.convertTo(image, image.type(), depth_scale);
+    if (flip) {
+      flipImageHorizontal(image.data, image.step, image.data, image.step, width, height,
+                          pixel_size);
+    }
+  } else if (convert_yuv) {
+    if (!convertYUVFrame(video_frame, image_msg->data.data(), image_msg->step)) {
+      return;
+    }
+    if (flip) {
+      flipImageHorizontal(image.data, image.step, image.data, image.step, width, height,
+                          pixel_size);
+    }
+  } else if (flip) {
+    flipImageHorizontal(src_data, image_msg->step, image_msg->data.data(), image_msg->step, width,
+                        height, pixel_size);
   } else {
-    cv::Mat flipped_image;
-    cv::flip(image, flipped_image, 1);
-    auto flipped_image_msg =
-        cv_bridge::CvImage(std_msgs::Header(), encoding_[stream_index], flipped_image).toImageMsg();
-    CHECK_NOTNULL(flipped_image_msg.get());
-    flipped_image_msg->header.stamp = timestamp;
-    flipped_image_msg->is_bigendian = false;
-    flipped_image_msg->step = width * unit_step_size_[stream_index];
-    flipped_image_msg->header.frame_id = depth_registration_ ? depth_aligned_frame_id_[stream_index]
-                                                             : optical_frame_id_[stream_index];
-    image_publisher.publish(flipped_image_msg);
+    memcpy(image_msg->data.data(), src_data, image_msg->data.size());
+  }
+  if (publish_meters) {
+    depth_meters_pub_.publish(meters_msg);
+  }
+  if (image_publishers_[stream_index].getNumSubscribers() > 0) {
+    image_publishers_[stream_index].publish(image_msg);
+  }
+  if (latency_stats_) {
+    latency_stats_->recordSince(latencyStage(end_to_end_latency_stages_, stream_index),
+                                video_frame->systemTimeStamp());
   }
   saveImageToFile(stream_index, image, image_msg);
 }
 
+bool OBCameraNode::hasImageSubscriber(const stream_index_pair& stream_index) {
+  if (image_publishers_[stream_index].getNumSubscribers() > 0) {
+    return true;
+  }
+  if (stream_index == COLOR && (color_preview_pub_.getNumSubscribers() > 0 ||
+                                 color_mono_pub_.getNumSubscribers() > 0 ||
+                                 color_compressed_pub_.getNumSubscribers() > 0)) {
+    return true;
+  }
+  return stream_index == DEPTH && depth_meters_pub_.getNumSubscribers() > 0;
+}
+
 void OBCameraNode::saveImageToFile(const stream_index_pair& stream_index, const cv::Mat& image,
                                    const sensor_msgs::ImagePtr& image_msg) {
   if (save_images_[stream_index]) {
@@ -937,6 +1825,9 @@ void OBCameraNode::saveImageToFile(const stream_index_pair& stream_index, const
     if (stream_index.first == OB_STREAM_DEPTH) {
       auto image_to_save = cv_bridge::toCvCopy(image_msg, encoding_[stream_index])->image;
       cv::imwrite(filename, image_to_save);
+    } else if (stream_index.first == OB_STREAM_COLOR && publish_native_color_) {
+      // Already converted to BGR by publishNativeColorImage.
+      cv::imwrite(filename, image);
     } else if (stream_index.first == OB_STREAM_COLOR) {
       auto image_to_save =
           cv_bridge::toCvCopy(image_msg, sensor_msgs::image_encodings::BGR8)->image;
@@ -1005,13 +1896,14 @@ void OBCameraNode::imageUnsubscribedCallback(const stream_index_pair& stream_ind
     }
     bool all_stream_no_subscriber = true;
     for (auto& item : image_publishers_) {
-      if (item.second.getNumSubscribers() > 0) {
+      if (hasImageSubscriber(item.first)) {
         all_stream_no_subscriber = false;
         break;
       }
     }
     if (enable_point_cloud_) {
-      if (depth_cloud_pub_.getNumSubscribers() > 0) {
+      if (depth_cloud_pub_.getNumSubscribers() > 0 ||
+          depth_cloud_downsampled_pub_.getNumSubscribers() > 0) {
         all_stream_no_subscriber = false;
       }
     }
@@ -1028,8 +1920,7 @@ void OBCameraNode::imageUnsubscribedCallback(const stream_index_pair& stream_ind
       ROS_INFO_STREAM("Stream " << stream_name_[stream_index] << " is not started.");
       return;
     }
-    auto subscriber_count = image_publishers_[stream_index].getNumSubscribers();
-    if (subscriber_count == 0) {
+    if (!hasImageSubscriber(stream_index)) {
       stopStream(stream_index);
     }
   }
@@ -1038,7 +1929,39 @@ void OBCameraNode::imageUnsubscribedCallback(const stream_index_pair& stream_ind
 void OBCameraNode::imuUnsubscribedCallback(const stream_index_pair& stream_index) {
   ROS_INFO_STREAM("IMU stream " << stream_name_[stream_index] << " unsubscribed");
   std::lock_guard<decltype(device_lock_)> lock(device_lock_);
-  stopIMU(stream_index);
+  if (!hasIMUSubscriber(stream_index)) {
+    stopIMU(stream_index);
+  }
+}
+
+bool OBCameraNode::hasIMUSubscriber(const stream_index_pair& stream_index) {
+  if (imu_orientation_pub_.getNumSubscribers() > 0) {
+    return true;
+  }
+  const IMUOutput* output = &united_output_;
+  if (unite_imu_method_ == UniteIMUMethod::NONE) {
+    output = stream_index == ACCEL ? &accel_output_ : &gyro_output_;
+  }
+  return output->publisher.getNumSubscribers() > 0 ||
+         output->batch_publisher.getNumSubscribers() > 0;
+}
+
+void OBCameraNode::unitedIMUSubscribedCallback() {
+  ROS_INFO_STREAM("United IMU stream subscribed");
+  std::lock_guard<decltype(device_lock_)> lock(device_lock_);
+  if (!imu_started_[ACCEL] || !imu_started_[GYRO]) {
+    resetUnitedIMU();
+  }
+  for (const auto& stream_index : HID_STREAMS) {
+    imuSubscribedCallback(stream_index);
+  }
+}
+
+void OBCameraNode::unitedIMUUnsubscribedCallback() {
+  ROS_INFO_STREAM("United IMU stream unsubscribed");
+  for (const auto& stream_index : HID_STREAMS) {
+    imuUnsubscribedCallback(stream_index);
+  }
 }
 
 void OBCameraNode::pointCloudSubscribedCallback() {
@@ -1048,7 +1971,8 @@ void OBCameraNode::pointCloudSubscribedCallback() {
 
 void OBCameraNode::pointCloudUnsubscribedCallback() {
   ROS_INFO_STREAM("point cloud unsubscribed");
-  if (depth_cloud_pub_.getNumSubscribers() > 0) {
+  if (depth_cloud_pub_.getNumSubscribers() > 0 ||
+      depth_cloud_downsampled_pub_.getNumSubscribers() > 0) {
     return;
   }
   imageUnsubscribedCallback(DEPTH);
@@ -1133,6 +2057,61 @@ boost::optional<OBCameraParam> OBCameraNode::getCameraColorParam() {
   return {};
 }
 
+OBCameraNode::CalibrationEntry& OBCameraNode::findCalibration(const stream_index_pair& stream_index,
+                                                              int width, int height, bool aligned) {
+  auto key = std::make_tuple(stream_index, width, height, aligned);
+  auto it = calibration_cache_.find(key);
+  if (it != calibration_cache_.end()) {
+    return it->second;
+  }
+  CalibrationEntry entry;
+  if (aligned && pipeline_) {
+    entry.param = pipeline_->getCameraParam();
+  } else if (aligned) {
+    entry.param = getCameraParam();
+  } else if (stream_index == COLOR) {
+    entry.param = getCameraColorParam();
+  } else {
+    entry.param = getCameraDepthParam();
+  }
+  if (entry.param) {
+    const auto& param = *entry.param;
+    entry.camera_info =
+        stream_index == COLOR
+            ? convertToCameraInfo(param.rgbIntrinsic, param.rgbDistortion, width)
+            : convertToCameraInfo(param.depthIntrinsic, param.depthDistortion, width);
+    entry.camera_info.width = width;
+    entry.camera_info.height = height;
+  } else {
+    // Cached as well, so that a missing calibration is not queried again on every frame.
+    ROS_WARN_STREAM("No calibration found for stream " << stream_name_[stream_index] << " at "
+                                                       << width << "x" << height);
+  }
+  return calibration_cache_.emplace(key, entry).first->second;
+}
+
+boost::optional<OBCameraParam> OBCameraNode::getCalibration(const stream_index_pair& stream_index,
+                                                            int width, int height, bool aligned) {
+  std::lock_guard<std::mutex> lock(calibration_cache_mutex_);
+  return findCalibration(stream_index, width, height, aligned).param;
+}
+
+bool OBCameraNode::getCameraInfo(const stream_index_pair& stream_index, int width, int height,
+                                 bool aligned, sensor_msgs::CameraInfo& camera_info) {
+  std::lock_guard<std::mutex> lock(calibration_cache_mutex_);
+  const auto& entry = findCalibration(stream_index, width, height, aligned);
+  if (!entry.param) {
+    return false;
+  }
+  camera_info = entry.camera_info;
+  return true;
+}
+
+void OBCameraNode::invalidateCalibrationCache() {
+  std::lock_guard<std::mutex> lock(calibration_cache_mutex_);
+  calibration_cache_.clear();
+}
+
 int OBCameraNode::getCameraParamIndex() {
   auto camera_params = device_->getCalibrationCameraParamList();
   for (size_t i = 0; i < camera_params->count(); i++) {
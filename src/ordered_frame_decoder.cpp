@@ -0,0 +1,113 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+
+#include "orbbec_camera/ordered_frame_decoder.h"
+#include <algorithm>
+
+namespace orbbec_camera {
+
+OrderedFrameDecoder::OrderedFrameDecoder(int thread_num, int max_in_flight, DecodeFunc decode,
+                                         OutputFunc output)
+    : decode_(std::move(decode)),
+      output_(std::move(output)),
+      slots_(static_cast<size_t>(std::max(max_in_flight, 1))) {
+  for (int i = 0; i < std::max(thread_num, 1); i++) {
+    threads_.emplace_back([this, i]() { decodeLoop(i); });
+  }
+  threads_.emplace_back([this]() { outputLoop(); });
+}
+
+OrderedFrameDecoder::~OrderedFrameDecoder() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  decode_cv_.notify_all();
+  output_cv_.notify_all();
+  for (auto &thread : threads_) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+}
+
+bool OrderedFrameDecoder::submit(const std::shared_ptr<ob::FrameSet> &frame_set) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stop_ || submitted_ - next_output_ >= slots_.size()) {
+      dropped_++;
+      return false;
+    }
+    auto &slot = slots_[submitted_ % slots_.size()];
+    slot.frame_set = frame_set;
+    slot.done = false;
+    submitted_++;
+  }
+  decode_cv_.notify_one();
+  return true;
+}
+
+uint64_t OrderedFrameDecoder::droppedCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return dropped_;
+}
+
+void OrderedFrameDecoder::decodeLoop(int worker) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    decode_cv_.wait(lock, [this]() { return stop_ || next_decode_ < submitted_; });
+    if (stop_) {
+      return;
+    }
+    auto &slot = slots_[next_decode_ % slots_.size()];
+    next_decode_++;
+    // The slot is not reused before it was output, so it can be filled unlocked.
+    lock.unlock();
+    bool decoded = false;
+    try {
+      decoded = decode_(worker, slot.frame_set, slot.buffer);
+    } catch (...) {
+      // decode_ reports its own errors, a throwing decode only loses this frame.
+      decoded = false;
+    }
+    lock.lock();
+    slot.decoded = decoded;
+    slot.done = true;
+    output_cv_.notify_one();
+  }
+}
+
+void OrderedFrameDecoder::outputLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    output_cv_.wait(lock, [this]() {
+      return stop_ || (next_output_ < submitted_ && slots_[next_output_ % slots_.size()].done);
+    });
+    if (stop_) {
+      return;
+    }
+    auto &slot = slots_[next_output_ % slots_.size()];
+    lock.unlock();
+    output_(slot.frame_set, slot.decoded ? slot.buffer.data() : nullptr);
+    slot.frame_set.reset();
+    lock.lock();
+    slot.done = false;
+    next_output_++;
+  }
+}
+
+}  // namespace orbbec_camera
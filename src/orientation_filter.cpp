@@ -0,0 +1,84 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#include "orbbec_camera/orientation_filter.h"
+#include <cmath>
+
+namespace orbbec_camera {
+namespace {
+// Gyro samples further apart are not integrated, e.g. after the stream restarted.
+const double MAX_GYRO_INTERVAL = 0.1;
+}  // namespace
+
+void OrientationFilter::updateAccel(const Eigen::Vector3d &accel) {
+  if (accel.squaredNorm() == 0.0) {
+    return;
+  }
+  accel_ = accel.normalized();
+  if (!initialized_) {
+    orientation_ = Eigen::Quaterniond::FromTwoVectors(accel_, Eigen::Vector3d::UnitZ());
+    initialized_ = true;
+  }
+}
+
+void OrientationFilter::updateGyro(const Eigen::Vector3d &gyro, double timestamp) {
+  const double dt = timestamp - last_timestamp_;
+  const bool integrate = initialized_ && last_timestamp_ >= 0 && dt > 0 && dt < MAX_GYRO_INTERVAL;
+  if (timestamp > last_timestamp_) {
+    last_timestamp_ = timestamp;
+  }
+  if (!integrate) {
+    return;
+  }
+  const double q0 = orientation_.w();
+  const double q1 = orientation_.x();
+  const double q2 = orientation_.y();
+  const double q3 = orientation_.z();
+  // The rate of change of the orientation from the gyro.
+  double dq0 = 0.5 * (-q1 * gyro.x() - q2 * gyro.y() - q3 * gyro.z());
+  double dq1 = 0.5 * (q0 * gyro.x() + q2 * gyro.z() - q3 * gyro.y());
+  double dq2 = 0.5 * (q0 * gyro.y() - q1 * gyro.z() + q3 * gyro.x());
+  double dq3 = 0.5 * (q0 * gyro.z() + q1 * gyro.y() - q2 * gyro.x());
+  // One gradient descent step towards the orientation that maps gravity to
+  // the measured acceleration.
+  const double ax = accel_.x();
+  const double ay = accel_.y();
+  const double az = accel_.z();
+  const double s0 = 4 * q0 * q2 * q2 + 2 * q2 * ax + 4 * q0 * q1 * q1 - 2 * q1 * ay;
+  const double s1 = 4 * q1 * q3 * q3 - 2 * q3 * ax + 4 * q0 * q0 * q1 - 2 * q0 * ay - 4 * q1 +
+                    8 * q1 * q1 * q1 + 8 * q1 * q2 * q2 + 4 * q1 * az;
+  const double s2 = 4 * q0 * q0 * q2 + 2 * q0 * ax + 4 * q2 * q3 * q3 - 2 * q3 * ay - 4 * q2 +
+                    8 * q2 * q1 * q1 + 8 * q2 * q2 * q2 + 4 * q2 * az;
+  const double s3 = 4 * q1 * q1 * q3 - 2 * q1 * ax + 4 * q2 * q2 * q3 - 2 * q2 * ay;
+  const double norm = std::sqrt(s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3);
+  if (norm > 0) {
+    dq0 -= gain_ * s0 / norm;
+    dq1 -= gain_ * s1 / norm;
+    dq2 -= gain_ * s2 / norm;
+    dq3 -= gain_ * s3 / norm;
+  }
+  orientation_ = Eigen::Quaterniond(q0 + dq0 * dt, q1 + dq1 * dt, q2 + dq2 * dt, q3 + dq3 * dt);
+  orientation_.normalize();
+}
+
+void OrientationFilter::reset() {
+  initialized_ = false;
+  accel_.setZero();
+  last_timestamp_ = -1.0;
+  orientation_.setIdentity();
+}
+
+}  // namespace orbbec_camera
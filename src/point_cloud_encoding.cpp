@@ -0,0 +1,200 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#include "orbbec_camera/point_cloud_encoding.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace orbbec_camera {
+namespace {
+constexpr float MM_PER_METER = 1000.0f;
+
+inline int16_t metersToMillimeters(float value) {
+  if (std::isnan(value)) {
+    return 0;
+  }
+  const float mm = std::min(std::max(value * MM_PER_METER, -32768.0f), 32767.0f);
+  return static_cast<int16_t>(std::nearbyint(mm));
+}
+
+#if defined(__SSE2__)
+// Vector version of floatToHalf on the raw float bits, one value per 32-bit lane.
+inline __m128i floatToHalf4(__m128 value) {
+  const __m128i bits = _mm_castps_si128(value);
+  const __m128i sign = _mm_and_si128(bits, _mm_set1_epi32(0x80000000));
+  const __m128i abs_bits = _mm_xor_si128(bits, sign);
+  // Lanes below the half float overflow threshold; all others become Inf or NaN.
+  const __m128i f16_max = _mm_set1_epi32((127 + 16) << 23);
+  const __m128i is_finite_range = _mm_cmpgt_epi32(f16_max, abs_bits);
+  const __m128i is_nan = _mm_cmpgt_epi32(abs_bits, _mm_set1_epi32(255 << 23));
+  const __m128i special =
+      _mm_or_si128(_mm_set1_epi32(0x7c00), _mm_and_si128(is_nan, _mm_set1_epi32(0x0200)));
+  // Subnormal or zero: let the FPU align the mantissa by adding a magic number.
+  const __m128i denorm_magic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+  const __m128i is_denorm = _mm_cmpgt_epi32(_mm_set1_epi32(113 << 23), abs_bits);
+  const __m128i denorm = _mm_sub_epi32(
+      _mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(abs_bits), _mm_castsi128_ps(denorm_magic))),
+      denorm_magic);
+  // Normal: rebias the exponent and round the mantissa to nearest even.
+  const __m128i mant_odd = _mm_and_si128(_mm_srli_epi32(abs_bits, 13), _mm_set1_epi32(1));
+  __m128i normal = _mm_add_epi32(abs_bits, _mm_set1_epi32(-(112 << 23) + 0xfff));
+  normal = _mm_srli_epi32(_mm_add_epi32(normal, mant_odd), 13);
+  __m128i half = _mm_or_si128(_mm_and_si128(is_denorm, denorm),
+                              _mm_andnot_si128(is_denorm, normal));
+  half = _mm_or_si128(_mm_and_si128(is_finite_range, half),
+                      _mm_andnot_si128(is_finite_range, special));
+  return _mm_or_si128(half, _mm_srli_epi32(sign, 16));
+}
+
+// Narrows 32-bit lanes holding 16-bit values without saturation.
+inline __m128i narrow16(__m128i low, __m128i high) {
+  return _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(low, 16), 16),
+                         _mm_srai_epi32(_mm_slli_epi32(high, 16), 16));
+}
+
+// Quantizes the xyz of one point, zeroing the padding lane.
+template <PointCloudEncoding kEncoding>
+inline __m128i quantizePoint(const uint8_t *in) {
+  const __m128 xyz = _mm_and_ps(_mm_loadu_ps(reinterpret_cast<const float *>(in)),
+                                _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1)));
+  if (kEncoding == PointCloudEncoding::INT16_MM) {
+    const __m128 mm = _mm_mul_ps(xyz, _mm_set1_ps(MM_PER_METER));
+    const __m128 clamped =
+        _mm_min_ps(_mm_max_ps(mm, _mm_set1_ps(-32768.0f)), _mm_set1_ps(32767.0f));
+    // max/min return their second operand for NaN, so mask NaN to 0 explicitly.
+    return _mm_and_si128(_mm_cvtps_epi32(clamped), _mm_castps_si128(_mm_cmpord_ps(mm, mm)));
+  }
+  return floatToHalf4(xyz);
+}
+
+template <PointCloudEncoding kEncoding>
+void quantizePointsImpl(const uint8_t *in, size_t count, size_t in_step, uint8_t *out,
+                        size_t out_step, bool colored, size_t in_rgb_offset) {
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    const __m128i packed = narrow16(quantizePoint<kEncoding>(in + i * in_step),
+                                    quantizePoint<kEncoding>(in + (i + 1) * in_step));
+    if (out_step == QUANTIZED_POINT_STEP) {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * out_step), packed);
+    } else {
+      _mm_storel_epi64(reinterpret_cast<__m128i *>(out + i * out_step), packed);
+      _mm_storel_epi64(reinterpret_cast<__m128i *>(out + (i + 1) * out_step),
+                       _mm_unpackhi_epi64(packed, packed));
+    }
+  }
+  for (; i < count; i++) {
+    const __m128i packed = narrow16(quantizePoint<kEncoding>(in + i * in_step), _mm_setzero_si128());
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(out + i * out_step), packed);
+  }
+  if (colored) {
+    for (i = 0; i < count; i++) {
+      memcpy(out + i * out_step + QUANTIZED_POINT_RGB_OFFSET, in + i * in_step + in_rgb_offset, 4);
+    }
+  }
+}
+#else
+template <PointCloudEncoding kEncoding>
+void quantizePointsImpl(const uint8_t *in, size_t count, size_t in_step, uint8_t *out,
+                        size_t out_step, bool colored, size_t in_rgb_offset) {
+  for (size_t i = 0; i < count; i++) {
+    float xyz[3];
+    memcpy(xyz, in + i * in_step, sizeof(xyz));
+    uint16_t packed[4] = {0, 0, 0, 0};
+#if defined(__aarch64__)
+    if (kEncoding == PointCloudEncoding::FLOAT16) {
+      const float32x4_t v = {xyz[0], xyz[1], xyz[2], 0.0f};
+      vst1_u16(packed, vreinterpret_u16_f16(vcvt_f16_f32(v)));
+      memcpy(out + i * out_step, packed, sizeof(packed));
+      if (colored) {
+        memcpy(out + i * out_step + QUANTIZED_POINT_RGB_OFFSET, in + i * in_step + in_rgb_offset,
+               4);
+      }
+      continue;
+    }
+#endif
+    for (int c = 0; c < 3; c++) {
+      packed[c] = kEncoding == PointCloudEncoding::INT16_MM
+                      ? static_cast<uint16_t>(metersToMillimeters(xyz[c]))
+                      : floatToHalf(xyz[c]);
+    }
+    memcpy(out + i * out_step, packed, sizeof(packed));
+    if (colored) {
+      memcpy(out + i * out_step + QUANTIZED_POINT_RGB_OFFSET, in + i * in_step + in_rgb_offset, 4);
+    }
+  }
+}
+#endif
+}  // namespace
+
+PointCloudEncoding pointCloudEncodingFromString(const std::string &encoding) {
+  if (encoding == "int16" || encoding == "int16_mm") {
+    return PointCloudEncoding::INT16_MM;
+  } else if (encoding == "float16" || encoding == "half") {
+    return PointCloudEncoding::FLOAT16;
+  }
+  return PointCloudEncoding::FLOAT32;
+}
+
+uint16_t floatToHalf(float value) {
+  uint32_t bits = 0;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint32_t sign = bits & 0x80000000u;
+  bits ^= sign;
+  uint32_t half = 0;
+  if (bits >= static_cast<uint32_t>(127 + 16) << 23) {
+    // Inf or NaN, including values too large for a half float.
+    half = bits > static_cast<uint32_t>(255) << 23 ? 0x7e00 : 0x7c00;
+  } else if (bits < static_cast<uint32_t>(113) << 23) {
+    // Subnormal or zero.
+    const uint32_t denorm_magic = static_cast<uint32_t>((127 - 15) + (23 - 10) + 1) << 23;
+    float f = 0.0f, magic = 0.0f;
+    memcpy(&f, &bits, sizeof(f));
+    memcpy(&magic, &denorm_magic, sizeof(magic));
+    f += magic;
+    memcpy(&half, &f, sizeof(half));
+    half -= denorm_magic;
+  } else {
+    const uint32_t mant_odd = (bits >> 13) & 1;
+    bits += (static_cast<uint32_t>(15 - 127) << 23) + 0xfff;
+    half = (bits + mant_odd) >> 13;
+  }
+  return static_cast<uint16_t>(half | (sign >> 16));
+}
+
+void quantizePoints(const uint8_t *in, size_t count, size_t in_step, PointCloudEncoding encoding,
+                    uint8_t *out, size_t out_step, bool colored, size_t in_rgb_offset) {
+  switch (encoding) {
+    case PointCloudEncoding::INT16_MM:
+      quantizePointsImpl<PointCloudEncoding::INT16_MM>(in, count, in_step, out, out_step, colored,
+                                                       in_rgb_offset);
+      break;
+    case PointCloudEncoding::FLOAT16:
+      quantizePointsImpl<PointCloudEncoding::FLOAT16>(in, count, in_step, out, out_step, colored,
+                                                      in_rgb_offset);
+      break;
+    default:
+      break;
+  }
+}
+
+}  // namespace orbbec_camera
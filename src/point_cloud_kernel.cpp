@@ -0,0 +1,589 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#include "orbbec_camera/point_cloud_kernel.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace orbbec_camera {
+namespace {
+// Points are published in meters while depth is in millimeters. The division
+// (instead of a multiplication by 0.001) keeps the output bit-identical to the
+// former scalar implementation.
+constexpr float MM_PER_METER = 1000.0f;
+
+inline void writePoint(uint8_t *out, float x, float y, float z) {
+  const float point[4] = {x, y, z, 0.0f};
+  memcpy(out, point, sizeof(point));
+}
+
+// Writes the pixel color in the byte order of a little-endian "rgb" field.
+inline void writeColor(uint8_t *out, const uint8_t *rgb) {
+  const uint8_t bgr[4] = {rgb[2], rgb[1], rgb[0], 0};
+  memcpy(out + COLORED_POINT_RGB_OFFSET, bgr, sizeof(bgr));
+}
+
+inline bool inBox(float x, float y, float z, const DepthFilter &filter) {
+  return x >= filter.box_min[0] && x <= filter.box_max[0] && y >= filter.box_min[1] &&
+         y <= filter.box_max[1] && z >= filter.box_min[2] && z <= filter.box_max[2];
+}
+
+#if defined(__SSE2__)
+// The filter broadcast to vector registers once per row.
+struct FilterVectors {
+  FilterVectors(float scale, const DepthFilter &filter)
+      : depth_scale(_mm_set1_ps(scale)),
+        min_depth(_mm_set1_ps(filter.min_depth)),
+        max_depth(_mm_set1_ps(filter.max_depth)) {
+    for (int i = 0; i < 3; i++) {
+      box_min[i] = _mm_set1_ps(filter.box_min[i]);
+      box_max[i] = _mm_set1_ps(filter.box_max[i]);
+    }
+  }
+
+  __m128 depth_scale, min_depth, max_depth;
+  __m128 box_min[3], box_max[3];
+};
+
+inline __m128 loadDepth4(__m128i raw, bool high) {
+  const __m128i zero = _mm_setzero_si128();
+  return _mm_cvtepi32_ps(high ? _mm_unpackhi_epi16(raw, zero) : _mm_unpacklo_epi16(raw, zero));
+}
+
+inline __m128 validDepthMask(__m128 depth, const FilterVectors &filter) {
+  return _mm_and_ps(_mm_cmpge_ps(depth, filter.min_depth), _mm_cmple_ps(depth, filter.max_depth));
+}
+
+// Computes the x, y, z planes of 4 points and returns the mask of the ones
+// inside the box, all ones if kBox is false.
+template <bool kBox>
+inline __m128 project4(__m128 depth, const float *ray_x, __m128 ray_y,
+                       const FilterVectors &filter, __m128 *xyz) {
+  const __m128 mm_per_meter = _mm_set1_ps(MM_PER_METER);
+  const __m128 z = _mm_mul_ps(depth, filter.depth_scale);
+  xyz[0] = _mm_div_ps(_mm_mul_ps(z, _mm_loadu_ps(ray_x)), mm_per_meter);
+  xyz[1] = _mm_div_ps(_mm_mul_ps(z, ray_y), mm_per_meter);
+  xyz[2] = _mm_div_ps(z, mm_per_meter);
+  __m128 in_box = _mm_castsi128_ps(_mm_set1_epi32(-1));
+  if (!kBox) {
+    return in_box;
+  }
+  for (int i = 0; i < 3; i++) {
+    in_box = _mm_and_ps(in_box, _mm_and_ps(_mm_cmpge_ps(xyz[i], filter.box_min[i]),
+                                           _mm_cmple_ps(xyz[i], filter.box_max[i])));
+  }
+  return in_box;
+}
+
+// Back-projects 4 depth values and appends the valid ones to out. Colored points
+// are filled by parallel bands, so only valid lanes are stored and nothing is
+// written past the last point. Otherwise every lane is stored but out only
+// advances past the valid ones, which keeps the loop branch-free. A lane is
+// never stored past its own pixel's slot, so the row's slots are never exceeded.
+template <bool kColored, bool kBox>
+inline uint8_t *backProject4(__m128 depth, const float *ray_x, __m128 ray_y,
+                             const FilterVectors &filter, const uint8_t *rgb, uint8_t *out,
+                             size_t point_step) {
+  const __m128 valid_depth = validDepthMask(depth, filter);
+  int mask = _mm_movemask_ps(valid_depth);
+  if (mask == 0) {
+    return out;
+  }
+  __m128 points[4];
+  const __m128 in_box = project4<kBox>(depth, ray_x, ray_y, filter, points);
+  if (kBox) {
+    mask = _mm_movemask_ps(_mm_and_ps(valid_depth, in_box));
+  }
+  points[3] = _mm_setzero_ps();
+  _MM_TRANSPOSE4_PS(points[0], points[1], points[2], points[3]);
+  if (!kColored) {
+    for (int i = 0; i < 4; i++) {
+      _mm_storeu_ps(reinterpret_cast<float *>(out), points[i]);
+      out += ((mask >> i) & 1) * point_step;
+    }
+    return out;
+  }
+  for (int lanes = mask; lanes != 0; lanes &= lanes - 1) {
+    const int i = __builtin_ctz(lanes);
+    _mm_storeu_ps(reinterpret_cast<float *>(out), points[i]);
+    writeColor(out, rgb + i * 3);
+    out += point_step;
+  }
+  return out;
+}
+#elif defined(__aarch64__)
+// The filter broadcast to vector registers once per row.
+struct FilterVectors {
+  FilterVectors(float scale, const DepthFilter &filter)
+      : depth_scale(vdupq_n_f32(scale)),
+        min_depth(vdupq_n_f32(filter.min_depth)),
+        max_depth(vdupq_n_f32(filter.max_depth)) {
+    for (int i = 0; i < 3; i++) {
+      box_min[i] = vdupq_n_f32(filter.box_min[i]);
+      box_max[i] = vdupq_n_f32(filter.box_max[i]);
+    }
+  }
+
+  float32x4_t depth_scale, min_depth, max_depth;
+  float32x4_t box_min[3], box_max[3];
+};
+
+inline uint32x4_t validDepthMask(float32x4_t depth, const FilterVectors &filter) {
+  return vandq_u32(vcgeq_f32(depth, filter.min_depth), vcleq_f32(depth, filter.max_depth));
+}
+
+// Computes the x, y, z planes of 4 points and returns the mask of the ones
+// inside the box, all ones if kBox is false.
+template <bool kBox>
+inline uint32x4_t project4(float32x4_t depth, const float *ray_x, float32x4_t ray_y,
+                           const FilterVectors &filter, float32x4x4_t &points) {
+  const float32x4_t mm_per_meter = vdupq_n_f32(MM_PER_METER);
+  const float32x4_t z = vmulq_f32(depth, filter.depth_scale);
+  points.val[0] = vdivq_f32(vmulq_f32(z, vld1q_f32(ray_x)), mm_per_meter);
+  points.val[1] = vdivq_f32(vmulq_f32(z, ray_y), mm_per_meter);
+  points.val[2] = vdivq_f32(z, mm_per_meter);
+  points.val[3] = vdupq_n_f32(0.0f);
+  uint32x4_t in_box = vdupq_n_u32(0xffffffff);
+  if (!kBox) {
+    return in_box;
+  }
+  for (int i = 0; i < 3; i++) {
+    in_box = vandq_u32(in_box, vandq_u32(vcgeq_f32(points.val[i], filter.box_min[i]),
+                                         vcleq_f32(points.val[i], filter.box_max[i])));
+  }
+  return in_box;
+}
+
+template <bool kColored, bool kBox>
+inline uint8_t *backProject4(float32x4_t depth, const float *ray_x, float32x4_t ray_y,
+                             const FilterVectors &filter, const uint8_t *rgb, uint8_t *out,
+                             size_t point_step) {
+  const uint32x4_t valid_depth = validDepthMask(depth, filter);
+  if (vmaxvq_u32(valid_depth) == 0) {
+    return out;
+  }
+  float32x4x4_t points;
+  const uint32x4_t valid =
+      vandq_u32(valid_depth, project4<kBox>(depth, ray_x, ray_y, filter, points));
+  if (!kColored && vminvq_u32(valid) != 0 && point_step == 4 * sizeof(float)) {
+    vst4q_f32(reinterpret_cast<float *>(out), points);
+    return out + 4 * point_step;
+  }
+  float xs[4], ys[4], zs[4];
+  uint32_t keep[4];
+  vst1q_f32(xs, points.val[0]);
+  vst1q_f32(ys, points.val[1]);
+  vst1q_f32(zs, points.val[2]);
+  vst1q_u32(keep, valid);
+  for (int i = 0; i < 4; i++) {
+    if (keep[i]) {
+      writePoint(out, xs[i], ys[i], zs[i]);
+      if (kColored) {
+        writeColor(out, rgb + i * 3);
+      }
+      out += point_step;
+    }
+  }
+  return out;
+}
+#endif
+
+template <bool kColored, bool kBox>
+size_t depthRowToPointsImpl(const uint16_t *depth_row, const uint8_t *rgb_row, const float *ray_x,
+                            float ray_y, int x_begin, int x_end, float depth_scale,
+                            const DepthFilter &filter, uint8_t *out, size_t point_step) {
+  uint8_t *const out_begin = out;
+  int x = x_begin;
+#if defined(__SSE2__)
+  const FilterVectors v_filter(depth_scale, filter);
+  const __m128 v_ray_y = _mm_set1_ps(ray_y);
+  for (; x + 8 <= x_end; x += 8) {
+    const __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i *>(depth_row + x));
+    const uint8_t *rgb = kColored ? rgb_row + x * 3 : nullptr;
+    out = backProject4<kColored, kBox>(loadDepth4(raw, false), ray_x + x, v_ray_y, v_filter, rgb,
+                                       out, point_step);
+    out = backProject4<kColored, kBox>(loadDepth4(raw, true), ray_x + x + 4, v_ray_y, v_filter,
+                                       kColored ? rgb + 12 : nullptr, out, point_step);
+  }
+#elif defined(__aarch64__)
+  const FilterVectors v_filter(depth_scale, filter);
+  const float32x4_t v_ray_y = vdupq_n_f32(ray_y);
+  for (; x + 8 <= x_end; x += 8) {
+    const uint16x8_t raw = vld1q_u16(depth_row + x);
+    const float32x4_t lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(raw)));
+    const float32x4_t hi = vcvtq_f32_u32(vmovl_high_u16(raw));
+    const uint8_t *rgb = kColored ? rgb_row + x * 3 : nullptr;
+    out = backProject4<kColored, kBox>(lo, ray_x + x, v_ray_y, v_filter, rgb, out, point_step);
+    out = backProject4<kColored, kBox>(hi, ray_x + x + 4, v_ray_y, v_filter,
+                                       kColored ? rgb + 12 : nullptr, out, point_step);
+  }
+#endif
+  for (; x < x_end; x++) {
+    const float depth = depth_row[x];
+    if (depth < filter.min_depth || depth > filter.max_depth) {
+      continue;
+    }
+    const float z = depth * depth_scale;
+    const float point[3] = {z * ray_x[x] / MM_PER_METER, z * ray_y / MM_PER_METER,
+                            z / MM_PER_METER};
+    if (kBox && !inBox(point[0], point[1], point[2], filter)) {
+      continue;
+    }
+    writePoint(out, point[0], point[1], point[2]);
+    if (kColored) {
+      writeColor(out, rgb_row + x * 3);
+    }
+    out += point_step;
+  }
+  return (out - out_begin) / point_step;
+}
+
+// Writes one point per pixel of [x_begin, x_end), NaN for invalid depth, so
+// every pixel has a fixed output slot and the loop has no data-dependent
+// branches or writes.
+template <bool kColored, bool kBox>
+void depthRowToOrganizedPointsImpl(const uint16_t *depth_row, const uint8_t *rgb_row,
+                                   const float *ray_x, float ray_y, int x_begin, int x_end,
+                                   float depth_scale, const DepthFilter &filter, uint8_t *out,
+                                   size_t point_step) {
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  int x = x_begin;
+#if defined(__SSE2__)
+  const FilterVectors v_filter(depth_scale, filter);
+  const __m128 v_ray_y = _mm_set1_ps(ray_y);
+  const __m128 v_nan = _mm_set1_ps(nan);
+  for (; x + 8 <= x_end; x += 8) {
+    const __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i *>(depth_row + x));
+    for (int half = 0; half < 2; half++) {
+      const int x0 = x + half * 4;
+      const __m128 depth = loadDepth4(raw, half == 1);
+      __m128 points[4];
+      const __m128 valid = _mm_and_ps(validDepthMask(depth, v_filter),
+                                      project4<kBox>(depth, ray_x + x0, v_ray_y, v_filter, points));
+      const __m128 invalid_nan = _mm_andnot_ps(valid, v_nan);
+      for (int i = 0; i < 3; i++) {
+        points[i] = _mm_or_ps(_mm_and_ps(valid, points[i]), invalid_nan);
+      }
+      points[3] = _mm_setzero_ps();
+      _MM_TRANSPOSE4_PS(points[0], points[1], points[2], points[3]);
+      uint8_t *dst = out + (x0 - x_begin) * point_step;
+      for (int i = 0; i < 4; i++) {
+        _mm_storeu_ps(reinterpret_cast<float *>(dst + i * point_step), points[i]);
+        if (kColored) {
+          writeColor(dst + i * point_step, rgb_row + (x0 + i) * 3);
+        }
+      }
+    }
+  }
+#elif defined(__aarch64__)
+  const FilterVectors v_filter(depth_scale, filter);
+  const float32x4_t v_ray_y = vdupq_n_f32(ray_y);
+  const float32x4_t v_nan = vdupq_n_f32(nan);
+  for (; x + 8 <= x_end; x += 8) {
+    const uint16x8_t raw = vld1q_u16(depth_row + x);
+    for (int half = 0; half < 2; half++) {
+      const int x0 = x + half * 4;
+      const float32x4_t depth = vcvtq_f32_u32(
+          half == 0 ? vmovl_u16(vget_low_u16(raw)) : vmovl_high_u16(raw));
+      float32x4x4_t points;
+      const uint32x4_t valid = vandq_u32(validDepthMask(depth, v_filter),
+                                         project4<kBox>(depth, ray_x + x0, v_ray_y, v_filter, points));
+      for (int i = 0; i < 3; i++) {
+        points.val[i] = vbslq_f32(valid, points.val[i], v_nan);
+      }
+      uint8_t *dst = out + (x0 - x_begin) * point_step;
+      if (!kColored && point_step == 4 * sizeof(float)) {
+        vst4q_f32(reinterpret_cast<float *>(dst), points);
+        continue;
+      }
+      float xs[4], ys[4], zs[4];
+      vst1q_f32(xs, points.val[0]);
+      vst1q_f32(ys, points.val[1]);
+      vst1q_f32(zs, points.val[2]);
+      for (int i = 0; i < 4; i++) {
+        writePoint(dst + i * point_step, xs[i], ys[i], zs[i]);
+        if (kColored) {
+          writeColor(dst + i * point_step, rgb_row + (x0 + i) * 3);
+        }
+      }
+    }
+  }
+#endif
+  for (; x < x_end; x++) {
+    uint8_t *dst = out + (x - x_begin) * point_step;
+    const float depth = depth_row[x];
+    const float z = depth * depth_scale;
+    const float point[3] = {z * ray_x[x] / MM_PER_METER, z * ray_y / MM_PER_METER,
+                            z / MM_PER_METER};
+    if (depth < filter.min_depth || depth > filter.max_depth ||
+        (kBox && !inBox(point[0], point[1], point[2], filter))) {
+      writePoint(dst, nan, nan, nan);
+    } else {
+      writePoint(dst, point[0], point[1], point[2]);
+    }
+    if (kColored) {
+      writeColor(dst, rgb_row + x * 3);
+    }
+  }
+}
+
+// Splits [0, height) into band_count contiguous bands of rows.
+inline void bandRows(int height, int band_count, int band, int &y_begin, int &y_end) {
+  y_begin = static_cast<int>(static_cast<int64_t>(height) * band / band_count);
+  y_end = static_cast<int>(static_cast<int64_t>(height) * (band + 1) / band_count);
+}
+
+inline int bandCount(const WorkerPool *pool, int height) {
+  return pool ? std::max(1, std::min(height, pool->concurrency() * 4)) : 1;
+}
+
+void depthRowToOrganizedPoints(const uint16_t *depth_row, const uint8_t *rgb_row,
+                               const float *ray_x, float ray_y, int x_begin, int x_end,
+                               float depth_scale, const DepthFilter &filter, uint8_t *out,
+                               size_t point_step) {
+  const bool has_box = filter.hasBox();
+  if (rgb_row && has_box) {
+    depthRowToOrganizedPointsImpl<true, true>(depth_row, rgb_row, ray_x, ray_y, x_begin, x_end,
+                                              depth_scale, filter, out, point_step);
+  } else if (rgb_row) {
+    depthRowToOrganizedPointsImpl<true, false>(depth_row, rgb_row, ray_x, ray_y, x_begin, x_end,
+                                               depth_scale, filter, out, point_step);
+  } else if (has_box) {
+    depthRowToOrganizedPointsImpl<false, true>(depth_row, nullptr, ray_x, ray_y, x_begin, x_end,
+                                               depth_scale, filter, out, point_step);
+  } else {
+    depthRowToOrganizedPointsImpl<false, false>(depth_row, nullptr, ray_x, ray_y, x_begin, x_end,
+                                                depth_scale, filter, out, point_step);
+  }
+}
+}  // namespace
+
+bool DepthRayTable::update(const OBCameraIntrinsic &intrinsic, int width, int height) {
+  if (!ray_x_.empty() && width == width_ && height == height_ &&
+      memcmp(&intrinsic, &intrinsic_, sizeof(intrinsic)) == 0) {
+    return false;
+  }
+  float fdx = intrinsic.fx * ((float)(width) / intrinsic.width);
+  float fdy = intrinsic.fy * ((float)(height) / intrinsic.height);
+  fdx = 1 / fdx;
+  fdy = 1 / fdy;
+  float u0 = intrinsic.cx * ((float)(width) / intrinsic.width);
+  float v0 = intrinsic.cy * ((float)(height) / intrinsic.height);
+  ray_x_.resize(width);
+  ray_y_.resize(height);
+  for (int x = 0; x < width; x++) {
+    ray_x_[x] = (x - u0) * fdx;
+  }
+  for (int y = 0; y < height; y++) {
+    ray_y_[y] = (y - v0) * fdy;
+  }
+  intrinsic_ = intrinsic;
+  width_ = width;
+  height_ = height;
+  return true;
+}
+
+bool DepthFilter::hasBox() const {
+  for (int i = 0; i < 3; i++) {
+    if (box_min[i] != -std::numeric_limits<float>::infinity() ||
+        box_max[i] != std::numeric_limits<float>::infinity()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void DepthFilter::roiBounds(int width, int height, int &x_begin, int &y_begin, int &x_end,
+                            int &y_end) const {
+  x_begin = std::min(std::max(roi_x, 0), width);
+  y_begin = std::min(std::max(roi_y, 0), height);
+  x_end = roi_width > 0 ? std::min(x_begin + roi_width, width) : width;
+  y_end = roi_height > 0 ? std::min(y_begin + roi_height, height) : height;
+}
+
+size_t depthRowToPoints(const uint16_t *depth_row, const float *ray_x, float ray_y, int x_begin,
+                        int x_end, float depth_scale, const DepthFilter &filter, uint8_t *out,
+                        size_t point_step) {
+  if (filter.hasBox()) {
+    return depthRowToPointsImpl<false, true>(depth_row, nullptr, ray_x, ray_y, x_begin, x_end,
+                                             depth_scale, filter, out, point_step);
+  }
+  return depthRowToPointsImpl<false, false>(depth_row, nullptr, ray_x, ray_y, x_begin, x_end,
+                                            depth_scale, filter, out, point_step);
+}
+
+size_t depthRowToColoredPoints(const uint16_t *depth_row, const uint8_t *rgb_row,
+                               const float *ray_x, float ray_y, int x_begin, int x_end,
+                               float depth_scale, const DepthFilter &filter, uint8_t *out,
+                               size_t point_step) {
+  if (filter.hasBox()) {
+    return depthRowToPointsImpl<true, true>(depth_row, rgb_row, ray_x, ray_y, x_begin, x_end,
+                                            depth_scale, filter, out, point_step);
+  }
+  return depthRowToPointsImpl<true, false>(depth_row, rgb_row, ray_x, ray_y, x_begin, x_end,
+                                           depth_scale, filter, out, point_step);
+}
+
+size_t countValidPoints(const uint16_t *depth_row, const float *ray_x, float ray_y, int x_begin,
+                        int x_end, float depth_scale, const DepthFilter &filter) {
+  // Without a box only the depth range matters and nothing needs to be projected.
+  const bool has_box = filter.hasBox();
+  size_t count = 0;
+  int x = x_begin;
+#if defined(__SSE2__)
+  const FilterVectors v_filter(depth_scale, filter);
+  const __m128 v_ray_y = _mm_set1_ps(ray_y);
+  for (; x + 8 <= x_end; x += 8) {
+    const __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i *>(depth_row + x));
+    for (int half = 0; half < 2; half++) {
+      const __m128 depth = loadDepth4(raw, half == 1);
+      __m128 valid = validDepthMask(depth, v_filter);
+      if (has_box && _mm_movemask_ps(valid) != 0) {
+        __m128 points[3];
+        valid = _mm_and_ps(valid, project4<true>(depth, ray_x + x + half * 4, v_ray_y, v_filter, points));
+      }
+      count += __builtin_popcount(_mm_movemask_ps(valid));
+    }
+  }
+#elif defined(__aarch64__)
+  const FilterVectors v_filter(depth_scale, filter);
+  const float32x4_t v_ray_y = vdupq_n_f32(ray_y);
+  for (; x + 8 <= x_end; x += 8) {
+    const uint16x8_t raw = vld1q_u16(depth_row + x);
+    for (int half = 0; half < 2; half++) {
+      const float32x4_t depth = vcvtq_f32_u32(
+          half == 0 ? vmovl_u16(vget_low_u16(raw)) : vmovl_high_u16(raw));
+      uint32x4_t valid = validDepthMask(depth, v_filter);
+      if (has_box && vmaxvq_u32(valid) != 0) {
+        float32x4x4_t points;
+        valid = vandq_u32(valid, project4<true>(depth, ray_x + x + half * 4, v_ray_y, v_filter, points));
+      }
+      count += vaddvq_u32(vshrq_n_u32(valid, 31));
+    }
+  }
+#endif
+  for (; x < x_end; x++) {
+    const float depth = depth_row[x];
+    if (depth < filter.min_depth || depth > filter.max_depth) {
+      continue;
+    }
+    const float z = depth * depth_scale;
+    if (!has_box ||
+        inBox(z * ray_x[x] / MM_PER_METER, z * ray_y / MM_PER_METER, z / MM_PER_METER, filter)) {
+      count++;
+    }
+  }
+  return count;
+}
+
+size_t depthToPoints(const uint16_t *depth, const DepthRayTable &table, float depth_scale,
+                     const DepthFilter &filter, uint8_t *out, size_t point_step) {
+  const int width = table.width();
+  const float *ray_x = table.rayX();
+  const float *ray_y = table.rayY();
+  int x_begin = 0, y_begin = 0, x_end = 0, y_end = 0;
+  filter.roiBounds(width, table.height(), x_begin, y_begin, x_end, y_end);
+  size_t count = 0;
+  for (int y = y_begin; y < y_end; y++) {
+    count += depthRowToPoints(depth + y * width, ray_x, ray_y[y], x_begin, x_end, depth_scale,
+                              filter, out + count * point_step, point_step);
+  }
+  return count;
+}
+
+size_t depthToColoredPoints(const uint16_t *depth, const uint8_t *rgb, const DepthRayTable &table,
+                            float depth_scale, const DepthFilter &filter, uint8_t *out,
+                            size_t point_step, WorkerPool *pool) {
+  const int width = table.width();
+  const float *ray_x = table.rayX();
+  const float *ray_y = table.rayY();
+  int x_begin = 0, y_begin = 0, x_end = 0, y_end = 0;
+  filter.roiBounds(width, table.height(), x_begin, y_begin, x_end, y_end);
+  if (!pool) {
+    size_t count = 0;
+    for (int y = y_begin; y < y_end; y++) {
+      count += depthRowToColoredPoints(depth + y * width, rgb + y * width * 3, ray_x, ray_y[y],
+                                       x_begin, x_end, depth_scale, filter,
+                                       out + count * point_step, point_step);
+    }
+    return count;
+  }
+  // Each band counts its valid points first, the prefix sum of the counts gives
+  // every band its write offset, so the bands can then be filled in parallel
+  // while keeping the row-major point order of a serial pass.
+  const int rows = y_end - y_begin;
+  const int band_count = bandCount(pool, rows);
+  std::vector<size_t> band_offsets(band_count + 1, 0);
+  pool->parallelFor(band_count, [&](int band) {
+    int band_begin = 0, band_end = 0;
+    bandRows(rows, band_count, band, band_begin, band_end);
+    size_t count = 0;
+    for (int y = y_begin + band_begin; y < y_begin + band_end; y++) {
+      count += countValidPoints(depth + y * width, ray_x, ray_y[y], x_begin, x_end, depth_scale,
+                                filter);
+    }
+    band_offsets[band + 1] = count;
+  });
+  std::partial_sum(band_offsets.begin(), band_offsets.end(), band_offsets.begin());
+  pool->parallelFor(band_count, [&](int band) {
+    int band_begin = 0, band_end = 0;
+    bandRows(rows, band_count, band, band_begin, band_end);
+    size_t count = band_offsets[band];
+    for (int y = y_begin + band_begin; y < y_begin + band_end; y++) {
+      count += depthRowToColoredPoints(depth + y * width, rgb + y * width * 3, ray_x, ray_y[y],
+                                       x_begin, x_end, depth_scale, filter,
+                                       out + count * point_step, point_step);
+    }
+  });
+  return band_offsets[band_count];
+}
+
+void depthToOrganizedPoints(const uint16_t *depth, const uint8_t *rgb, const DepthRayTable &table,
+                            float depth_scale, const DepthFilter &filter, uint8_t *out,
+                            size_t point_step, WorkerPool *pool) {
+  const int width = table.width();
+  const float *ray_x = table.rayX();
+  const float *ray_y = table.rayY();
+  int x_begin = 0, y_begin = 0, x_end = 0, y_end = 0;
+  filter.roiBounds(width, table.height(), x_begin, y_begin, x_end, y_end);
+  const int rows = y_end - y_begin;
+  const size_t row_step = (x_end - x_begin) * point_step;
+  const int band_count = bandCount(pool, rows);
+  auto fill_band = [&](int band) {
+    int band_begin = 0, band_end = 0;
+    bandRows(rows, band_count, band, band_begin, band_end);
+    for (int y = y_begin + band_begin; y < y_begin + band_end; y++) {
+      depthRowToOrganizedPoints(depth + y * width, rgb ? rgb + y * width * 3 : nullptr, ray_x,
+                                ray_y[y], x_begin, x_end, depth_scale, filter,
+                                out + (y - y_begin) * row_step, point_step);
+    }
+  };
+  if (pool) {
+    pool->parallelFor(band_count, fill_band);
+  } else {
+    fill_band(0);
+  }
+}
+
+}  // namespace orbbec_camera
@@ -193,6 +193,12 @@ void OBCameraNode::setupCameraCtrlServices() {
         response.success = this->getDeviceTypeCallback(request, response);
         return response.success;
       });
+  get_latency_stats_srv_ = nh_.advertiseService<GetStringRequest, GetStringResponse>(
+      "/" + camera_name_ + "/" + "get_latency_stats",
+      [this](GetStringRequest& request, GetStringResponse& response) {
+        response.success = this->getLatencyStatsCallback(request, response);
+        return response.success;
+      });
   save_point_cloud_srv_ = nh_.advertiseService<std_srvs::EmptyRequest, std_srvs::EmptyResponse>(
       "/" + camera_name_ + "/" + "save_point_cloud",
       [this](std_srvs::EmptyRequest& request, std_srvs::EmptyResponse& response) {
@@ -215,6 +221,13 @@ void OBCameraNode::setupCameraCtrlServices() {
         response.success = this->switchIRDataSourceChannelCallback(request, response);
         return response.success;
       });
+  set_point_cloud_filter_srv_ =
+      nh_.advertiseService<SetPointCloudFilterRequest, SetPointCloudFilterResponse>(
+          "/" + camera_name_ + "/" + "set_point_cloud_filter",
+          [this](SetPointCloudFilterRequest& request, SetPointCloudFilterResponse& response) {
+            response.success = this->setPointCloudFilterCallback(request, response);
+            return response.success;
+          });
 }
 
 bool OBCameraNode::setMirrorCallback(std_srvs::SetBoolRequest& request,
@@ -615,6 +628,40 @@ bool OBCameraNode::getCameraParamsCallback(orbbec_camera::GetCameraParamsRequest
   return true;
 }
 
+bool OBCameraNode::getLatencyStatsCallback(GetStringRequest& request,
+                                           GetStringResponse& response) {
+  (void)request;
+  if (!latency_stats_) {
+    response.message = "Latency stats are disabled, diagnostics_period is 0";
+    return false;
+  }
+  nlohmann::json data;
+  data["period"] = diagnostics_period_;
+  {
+    std::lock_guard<std::mutex> lock(latency_summaries_mutex_);
+    for (const auto& summary : latency_summaries_) {
+      auto& stage = data["stages"][summary.name];
+      stage["count"] = summary.count;
+      stage["rate_hz"] = summary.rate;
+      stage["p50_ms"] = summary.p50_ms;
+      stage["p99_ms"] = summary.p99_ms;
+      stage["max_ms"] = summary.max_ms;
+    }
+  }
+  if (buffer_arena_) {
+    const auto stats = buffer_arena_->stats();
+    auto& buffers = data["frame_buffers"];
+    buffers["reserved_bytes"] = stats.reserved_bytes;
+    buffers["in_use_bytes"] = stats.in_use_bytes;
+    buffers["high_water_bytes"] = stats.high_water_bytes;
+    buffers["acquisitions"] = stats.acquisitions;
+    buffers["misses"] = stats.misses;
+  }
+  response.data = data.dump(2);
+  response.success = true;
+  return true;
+}
+
 bool OBCameraNode::getSerialNumberCallback(GetStringRequest& request, GetStringResponse& response) {
   (void)request;
   std::lock_guard<decltype(device_lock_)> lock(device_lock_);
@@ -752,4 +799,23 @@ bool OBCameraNode::switchIRDataSourceChannelCallback(SetStringRequest& request,
   }
   return false;
 }
+
+bool OBCameraNode::setPointCloudFilterCallback(SetPointCloudFilterRequest& request,
+                                               SetPointCloudFilterResponse& response) {
+  DepthFilter filter;
+  filter.roi_x = request.roi_x;
+  filter.roi_y = request.roi_y;
+  filter.roi_width = request.roi_width;
+  filter.roi_height = request.roi_height;
+  for (int i = 0; i < 3; i++) {
+    filter.box_min[i] = request.box_min[i];
+    filter.box_max[i] = request.box_max[i];
+  }
+  response.message = setPointCloudFilter(request.min_distance, request.max_distance, filter);
+  if (!response.message.empty()) {
+    ROS_ERROR_STREAM("Failed to set point cloud filter: " << response.message);
+    return false;
+  }
+  return true;
+}
 }  // namespace orbbec_camera
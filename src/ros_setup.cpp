@@ -94,6 +94,7 @@ void OBCameraNode::setupDevices() {
     }
     if (!depth_work_mode_.empty()) {
       device_->switchDepthWorkMode(depth_work_mode_.c_str());
+      invalidateCalibrationCache();
     }
     if (sync_mode_ != OB_MULTI_DEVICE_SYNC_MODE_FREE_RUN) {
       auto sync_config = device_->getMultiDeviceSyncConfig();
@@ -112,6 +113,7 @@ void OBCameraNode::setupDevices() {
       auto default_precision_level = device_->getIntProperty(OB_PROP_DEPTH_PRECISION_LEVEL_INT);
       if (default_precision_level != depth_precision_) {
         device_->setIntProperty(OB_PROP_DEPTH_PRECISION_LEVEL_INT, depth_precision_);
+        invalidateCalibrationCache();
       }
     }
 
@@ -147,24 +149,28 @@ void OBCameraNode::setupFrameCallback() {
 }
 
 bool OBCameraNode::setupFormatConvertType(OBFormat type) {
+  return setupFormatConvertType(type, format_convert_filter_);
+}
+
+bool OBCameraNode::setupFormatConvertType(OBFormat type, ob::FormatConvertFilter& filter) {
   switch (type) {
     case OB_FORMAT_I420:
-      format_convert_filter_.setFormatConvertType(FORMAT_I420_TO_RGB888);
+      filter.setFormatConvertType(FORMAT_I420_TO_RGB888);
       break;
     case OB_FORMAT_MJPG:
-      format_convert_filter_.setFormatConvertType(FORMAT_MJPEG_TO_RGB888);
+      filter.setFormatConvertType(FORMAT_MJPEG_TO_RGB888);
       break;
     case OB_FORMAT_YUYV:
-      format_convert_filter_.setFormatConvertType(FORMAT_YUYV_TO_RGB888);
+      filter.setFormatConvertType(FORMAT_YUYV_TO_RGB888);
       break;
     case OB_FORMAT_NV21:
-      format_convert_filter_.setFormatConvertType(FORMAT_NV21_TO_RGB888);
+      filter.setFormatConvertType(FORMAT_NV21_TO_RGB888);
       break;
     case OB_FORMAT_NV12:
-      format_convert_filter_.setFormatConvertType(FORMAT_NV12_TO_RGB888);
+      filter.setFormatConvertType(FORMAT_NV12_TO_RGB888);
       break;
     case OB_FORMAT_UYVY:
-      format_convert_filter_.setFormatConvertType(FORMAT_UYVY_TO_RGB888);
+      filter.setFormatConvertType(FORMAT_UYVY_TO_RGB888);
       break;
     default:
       return false;
@@ -173,6 +179,7 @@ bool OBCameraNode::setupFormatConvertType(OBFormat type) {
 }
 
 void OBCameraNode::setupProfiles() {
+  invalidateCalibrationCache();
   for (const auto& stream_index : IMAGE_STREAMS) {
     if (!enable_stream_[stream_index]) {
       continue;
@@ -201,8 +208,6 @@ void OBCameraNode::setupProfiles() {
     }
     CHECK_NOTNULL(selected_profile.get());
     stream_profile_[stream_index] = selected_profile;
-    images_[stream_index] = cv::Mat(height_[stream_index], width_[stream_index],
-                                    image_format_[stream_index], cv::Scalar(0, 0, 0));
     ROS_INFO_STREAM(" stream " << stream_name_[stream_index] << " is enabled - width: "
                                << width_[stream_index] << ", height: " << height_[stream_index]
                                << ", fps: " << fps_[stream_index] << ", "
@@ -220,6 +225,7 @@ void OBCameraNode::setupProfiles() {
 }
 
 void OBCameraNode::setupTopics() {
+  setupPointCloudLayouts();
   setupPublishers();
   if (publish_tf_) {
     publishStaticTransforms();
@@ -231,6 +237,10 @@ void OBCameraNode::setupPublishers() {
     if (!enable_stream_[stream_index]) {
       continue;
     }
+    // Created here because the per-sensor callbacks run concurrently without the pipeline, and
+    // must not insert into the maps.
+    image_pools_.emplace(stream_index, MessagePool<sensor_msgs::Image>());
+    camera_info_pools_.emplace(stream_index, MessagePool<sensor_msgs::CameraInfo>());
     std::string name = stream_name_[stream_index];
     std::string topic_name = "/" + camera_name_ + "/" + name + "/image_raw";
     ros::SubscriberStatusCallback image_subscribed_cb =
@@ -242,6 +252,26 @@ void OBCameraNode::setupPublishers() {
     topic_name = "/" + camera_name_ + "/" + name + "/camera_info";
     camera_info_publishers_[stream_index] = nh_.advertise<sensor_msgs::CameraInfo>(
         topic_name, 1, image_subscribed_cb, image_unsubscribed_cb);
+    if (stream_index == DEPTH && enable_depth_meters_) {
+      topic_name = "/" + camera_name_ + "/" + name + "/image_meters";
+      depth_meters_pub_ = nh_.advertise<sensor_msgs::Image>(topic_name, 1, image_subscribed_cb,
+                                                            image_unsubscribed_cb);
+    }
+    if (stream_index == COLOR && enable_color_preview_) {
+      topic_name = "/" + camera_name_ + "/" + name + "/image_preview";
+      color_preview_pub_ = nh_.advertise<sensor_msgs::Image>(topic_name, 1, image_subscribed_cb,
+                                                             image_unsubscribed_cb);
+    }
+    if (stream_index == COLOR && format_[COLOR] == OB_FORMAT_MJPG) {
+      topic_name = "/" + camera_name_ + "/" + name + "/image_raw/compressed";
+      color_compressed_pub_ = nh_.advertise<sensor_msgs::CompressedImage>(
+          topic_name, 1, image_subscribed_cb, image_unsubscribed_cb);
+    }
+    if (stream_index == COLOR && enable_color_mono_) {
+      topic_name = "/" + camera_name_ + "/" + name + "/image_mono";
+      color_mono_pub_ = nh_.advertise<sensor_msgs::Image>(topic_name, 1, image_subscribed_cb,
+                                                          image_unsubscribed_cb);
+    }
   }
   if (enable_point_cloud_) {
     ros::SubscriberStatusCallback depth_cloud_subscribed_cb =
@@ -250,6 +280,8 @@ void OBCameraNode::setupPublishers() {
         boost::bind(&OBCameraNode::pointCloudUnsubscribedCallback, this);
     depth_cloud_pub_ = nh_.advertise<sensor_msgs::PointCloud2>(
         "depth/points", 1, depth_cloud_subscribed_cb, depth_cloud_unsubscribed_cb);
+    depth_cloud_downsampled_pub_ = nh_.advertise<sensor_msgs::PointCloud2>(
+        "depth/points_downsampled", 1, depth_cloud_subscribed_cb, depth_cloud_unsubscribed_cb);
   }
   if (enable_colored_point_cloud_) {
     ros::SubscriberStatusCallback depth_registered_cloud_subscribed_cb =
@@ -260,18 +292,123 @@ void OBCameraNode::setupPublishers() {
         "depth_registered/points", 1, depth_registered_cloud_subscribed_cb,
         depth_registered_cloud_unsubscribed_cb);
   }
+  if (unite_imu_method_ != UniteIMUMethod::NONE) {
+    // Accel and gyro are on one chip, the united samples use the gyro frame.
+    ros::SubscriberStatusCallback imu_subscribed_cb =
+        boost::bind(&OBCameraNode::unitedIMUSubscribedCallback, this);
+    ros::SubscriberStatusCallback imu_unsubscribed_cb =
+        boost::bind(&OBCameraNode::unitedIMUUnsubscribedCallback, this);
+    setupIMUOutput(united_output_, "imu", optical_frame_id_[GYRO], imu_subscribed_cb,
+                   imu_unsubscribed_cb);
+  }
+  if (enable_imu_orientation_) {
+    setDefaultIMUMessage(imu_orientation_msg_);
+    imu_orientation_msg_.header.frame_id = optical_frame_id_[GYRO];
+    // The orientation is filled, with an unknown covariance.
+    imu_orientation_msg_.orientation_covariance[0] = 0.0;
+    ros::SubscriberStatusCallback imu_subscribed_cb =
+        boost::bind(&OBCameraNode::unitedIMUSubscribedCallback, this);
+    ros::SubscriberStatusCallback imu_unsubscribed_cb =
+        boost::bind(&OBCameraNode::unitedIMUUnsubscribedCallback, this);
+    imu_orientation_pub_ = nh_.advertise<sensor_msgs::Imu>("imu/orientation", 1, imu_subscribed_cb,
+                                                           imu_unsubscribed_cb);
+  }
   for (const auto& stream_index : HID_STREAMS) {
-    if (!enable_stream_[stream_index]) {
+    if (!enable_stream_[stream_index] || unite_imu_method_ != UniteIMUMethod::NONE) {
       continue;
     }
-    std::string topic_name = stream_name_[stream_index] + "/sample";
     ros::SubscriberStatusCallback imu_subscribed_cb =
         boost::bind(&OBCameraNode::imuSubscribedCallback, this, stream_index);
     ros::SubscriberStatusCallback imu_unsubscribed_cb =
         boost::bind(&OBCameraNode::imuUnsubscribedCallback, this, stream_index);
-    imu_publishers_[stream_index] =
-        nh_.advertise<sensor_msgs::Imu>(topic_name, 1, imu_subscribed_cb, imu_unsubscribed_cb);
+    setupIMUOutput(stream_index == ACCEL ? accel_output_ : gyro_output_,
+                   stream_name_[stream_index], optical_frame_id_[stream_index], imu_subscribed_cb,
+                   imu_unsubscribed_cb);
+  }
+}
+
+void OBCameraNode::setupIMUOutput(IMUOutput& output, const std::string& name,
+                                  const std::string& frame_id,
+                                  const ros::SubscriberStatusCallback& subscribed_cb,
+                                  const ros::SubscriberStatusCallback& unsubscribed_cb) {
+  setDefaultIMUMessage(output.msg);
+  output.msg.header.frame_id = frame_id;
+  output.publisher =
+      nh_.advertise<sensor_msgs::Imu>(name + "/sample", 1, subscribed_cb, unsubscribed_cb);
+  if (imu_batch_size_ > 0) {
+    output.batch.header.frame_id = frame_id;
+    output.batch.samples.assign(imu_batch_size_, output.msg);
+    output.batch_publisher =
+        nh_.advertise<ImuBatch>(name + "/sample_batch", 1, subscribed_cb, unsubscribed_cb);
+  }
+}
+
+void OBCameraNode::setupLatencyStats() {
+  if (diagnostics_period_ <= 0) {
+    return;
+  }
+  latency_stats_.reset(new LatencyStats());
+  for (const auto& stream_index : IMAGE_STREAMS) {
+    if (!enable_stream_[stream_index]) {
+      continue;
+    }
+    const std::string& name = stream_name_[stream_index];
+    delivery_latency_stages_[stream_index] = latency_stats_->addStage(name + "/delivery");
+    publish_latency_stages_[stream_index] = latency_stats_->addStage(name + "/publish");
+    end_to_end_latency_stages_[stream_index] = latency_stats_->addStage(name + "/end_to_end");
+  }
+  if (enable_stream_[COLOR]) {
+    color_decode_latency_stage_ = latency_stats_->addStage("color/decode");
+  }
+  if (enable_point_cloud_ || enable_colored_point_cloud_) {
+    point_cloud_latency_stage_ = latency_stats_->addStage("depth/point_cloud");
+  }
+  for (const auto& stream_index : HID_STREAMS) {
+    if (enable_stream_[stream_index]) {
+      end_to_end_latency_stages_[stream_index] =
+          latency_stats_->addStage(stream_name_[stream_index] + "/end_to_end");
+    }
+  }
+  diagnostics_pub_ = nh_.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
+  diagnostics_timer_ = nh_.createWallTimer(ros::WallDuration(diagnostics_period_),
+                                           [this](const ros::WallTimerEvent&) {
+                                             publishDiagnostics();
+                                           });
+}
+
+int OBCameraNode::latencyStage(const std::map<stream_index_pair, int>& stages,
+                               const stream_index_pair& stream_index) const {
+  auto it = stages.find(stream_index);
+  return it == stages.end() ? -1 : it->second;
+}
+
+void OBCameraNode::setupPointCloudLayouts() {
+  sensor_msgs::PointCloud2 cloud_msg;
+  sensor_msgs::PointCloud2Modifier modifier(cloud_msg);
+  modifier.setPointCloud2FieldsByString(1, "xyz");
+  depth_cloud_layout_.fields = cloud_msg.fields;
+  depth_cloud_layout_.point_step = cloud_msg.point_step;
+  cloud_msg.point_step = addPointField(cloud_msg, "rgb", 1, sensor_msgs::PointField::FLOAT32,
+                                       static_cast<int>(COLORED_POINT_RGB_OFFSET));
+  colored_cloud_layout_.fields = cloud_msg.fields;
+  colored_cloud_layout_.point_step = cloud_msg.point_step;
+  if (point_cloud_encoding_ == PointCloudEncoding::FLOAT32) {
+    return;
   }
+  // PointField has no half float type, half floats are published as UINT16 bit patterns.
+  const int datatype = point_cloud_encoding_ == PointCloudEncoding::INT16_MM
+                           ? sensor_msgs::PointField::INT16
+                           : sensor_msgs::PointField::UINT16;
+  cloud_msg.fields.clear();
+  int offset = addPointField(cloud_msg, "x", 1, datatype, 0);
+  offset = addPointField(cloud_msg, "y", 1, datatype, offset);
+  addPointField(cloud_msg, "z", 1, datatype, offset);
+  quantized_cloud_layout_.fields = cloud_msg.fields;
+  quantized_cloud_layout_.point_step = QUANTIZED_POINT_STEP;
+  quantized_colored_cloud_layout_.point_step =
+      addPointField(cloud_msg, "rgb", 1, sensor_msgs::PointField::FLOAT32,
+                    static_cast<int>(QUANTIZED_POINT_RGB_OFFSET));
+  quantized_colored_cloud_layout_.fields = cloud_msg.fields;
 }
 
 void OBCameraNode::setupCameraInfo() {
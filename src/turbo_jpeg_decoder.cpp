@@ -0,0 +1,110 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#include "orbbec_camera/turbo_jpeg_decoder.h"
+#include "orbbec_camera/utils.h"
+#include <ros/ros.h>
+#include <algorithm>
+
+namespace orbbec_camera {
+
+namespace {
+// Rows handed to jpeg_read_scanlines per call, enough for one iMCU row at 4:2:0.
+const int MAX_SCANLINES = 16;
+
+J_COLOR_SPACE toColorSpace(TurboJPEGDecoder::PixelFormat format) {
+  switch (format) {
+    case TurboJPEGDecoder::PixelFormat::BGR:
+      return JCS_EXT_BGR;
+    case TurboJPEGDecoder::PixelFormat::GRAY:
+      return JCS_GRAYSCALE;
+    default:
+      return JCS_EXT_RGB;
+  }
+}
+}  // namespace
+
+TurboJPEGDecoder::TurboJPEGDecoder(int width, int height, PixelFormat format)
+    : JPEGDecoder(width, height), format_(format) {
+  cinfo_.err = jpeg_std_error(&error_manager_.pub);
+  error_manager_.pub.error_exit = onError;
+  error_manager_.pub.output_message = onMessage;
+  jpeg_create_decompress(&cinfo_);
+}
+
+TurboJPEGDecoder::~TurboJPEGDecoder() { jpeg_destroy_decompress(&cinfo_); }
+
+void TurboJPEGDecoder::onError(j_common_ptr cinfo) {
+  char message[JMSG_LENGTH_MAX];
+  (*cinfo->err->format_message)(cinfo, message);
+  ROS_ERROR_STREAM_THROTTLE(1.0, "libjpeg: " << message);
+  auto error_manager = reinterpret_cast<ErrorManager*>(cinfo->err);
+  longjmp(error_manager->jump_buffer, 1);
+}
+
+void TurboJPEGDecoder::onMessage(j_common_ptr cinfo) {
+  char message[JMSG_LENGTH_MAX];
+  (*cinfo->err->format_message)(cinfo, message);
+  ROS_DEBUG_STREAM("libjpeg: " << message);
+}
+
+bool TurboJPEGDecoder::decode(const std::shared_ptr<ob::ColorFrame>& frame, uint8_t* dest) {
+  if (!isValidJPEG(frame)) {
+    ROS_ERROR_STREAM_THROTTLE(1.0, "Invalid JPEG");
+    return false;
+  }
+  return decode(static_cast<const uint8_t*>(frame->data()), frame->dataSize(), dest,
+                static_cast<size_t>(width_) * pixelSize(format_), format_);
+}
+
+bool TurboJPEGDecoder::decode(const uint8_t* data, size_t size, uint8_t* dest, size_t dest_step,
+                              PixelFormat format, int scale_denom) {
+  if (scale_denom != 1 && scale_denom != 2 && scale_denom != 4 && scale_denom != 8) {
+    ROS_ERROR_STREAM("Unsupported JPEG scale 1/" << scale_denom);
+    return false;
+  }
+  if (setjmp(error_manager_.jump_buffer)) {
+    // Resets the decompressor so that it can be reused for the next frame.
+    jpeg_abort_decompress(&cinfo_);
+    return false;
+  }
+  jpeg_mem_src(&cinfo_, const_cast<uint8_t*>(data), static_cast<unsigned long>(size));
+  jpeg_read_header(&cinfo_, TRUE);
+  if (static_cast<int>(cinfo_.image_width) != width_ ||
+      static_cast<int>(cinfo_.image_height) != height_) {
+    ROS_ERROR_STREAM_THROTTLE(
+        1.0, "Unexpected JPEG size: " << cinfo_.image_width << "x" << cinfo_.image_height);
+    jpeg_abort_decompress(&cinfo_);
+    return false;
+  }
+  cinfo_.out_color_space = toColorSpace(format);
+  cinfo_.scale_num = 1;
+  cinfo_.scale_denom = scale_denom;
+  jpeg_start_decompress(&cinfo_);
+  JSAMPROW rows[MAX_SCANLINES];
+  while (cinfo_.output_scanline < cinfo_.output_height) {
+    JDIMENSION count = std::min<JDIMENSION>(MAX_SCANLINES,
+                                            cinfo_.output_height - cinfo_.output_scanline);
+    for (JDIMENSION i = 0; i < count; i++) {
+      rows[i] = dest + (cinfo_.output_scanline + i) * dest_step;
+    }
+    jpeg_read_scanlines(&cinfo_, rows, count);
+  }
+  jpeg_finish_decompress(&cinfo_);
+  return true;
+}
+
+}  // namespace orbbec_camera
@@ -22,6 +22,7 @@
 #include "sensor_msgs/point_cloud2_iterator.h"
 #include "sensor_msgs/point_cloud_conversion.h"
 #include "ros/ros.h"
+#include <sensor_msgs/image_encodings.h>
 
 namespace orbbec_camera {
 OBFormat OBFormatFromString(const std::string &format) {
@@ -136,6 +137,27 @@ std::string OBFormatToString(const OBFormat &format) {
   }
 }
 
+std::string nativeColorEncoding(const OBFormat &format) {
+  // Formats without a ROS encoding return "", they are published as rgb8.
+  switch (format) {
+#if defined(SENSOR_MSGS_YUV_ENCODINGS)
+    case OB_FORMAT_YUYV:
+    case OB_FORMAT_YUY2:
+      return sensor_msgs::image_encodings::YUV422_YUY2;
+    case OB_FORMAT_NV21:
+      return sensor_msgs::image_encodings::NV21;
+#endif
+    case OB_FORMAT_UYVY:
+      return sensor_msgs::image_encodings::YUV422;
+    case OB_FORMAT_RGB888:
+      return sensor_msgs::image_encodings::RGB8;
+    case OB_FORMAT_BGR:
+      return sensor_msgs::image_encodings::BGR8;
+    default:
+      return "";
+  }
+}
+
 std::string ObDeviceTypeToString(const OBDeviceType &type) {
   switch (type) {
     case OBDeviceType::OB_STRUCTURED_LIGHT_BINOCULAR_CAMERA:
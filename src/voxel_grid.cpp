@@ -0,0 +1,129 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#include "orbbec_camera/voxel_grid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace orbbec_camera {
+
+namespace {
+const size_t INITIAL_TABLE_SIZE = 1 << 14;
+const int KEY_BITS = 21;
+const uint64_t KEY_MASK = (1ull << KEY_BITS) - 1;
+
+inline uint64_t voxelKey(float x, float y, float z, float inv_leaf_size) {
+  const auto ix = static_cast<int64_t>(std::floor(x * inv_leaf_size));
+  const auto iy = static_cast<int64_t>(std::floor(y * inv_leaf_size));
+  const auto iz = static_cast<int64_t>(std::floor(z * inv_leaf_size));
+  return (static_cast<uint64_t>(ix) & KEY_MASK) |
+         ((static_cast<uint64_t>(iy) & KEY_MASK) << KEY_BITS) |
+         ((static_cast<uint64_t>(iz) & KEY_MASK) << (2 * KEY_BITS));
+}
+
+inline size_t hashKey(uint64_t key, size_t mask) {
+  return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+}
+}  // namespace
+
+VoxelSelection voxelSelectionFromString(const std::string &selection) {
+  if (selection == "first" || selection == "first_point") {
+    return VoxelSelection::FIRST_POINT;
+  }
+  return VoxelSelection::CENTROID;
+}
+
+VoxelGrid::VoxelGrid(float leaf_size, VoxelSelection selection) : selection_(selection) {
+  setLeafSize(leaf_size);
+}
+
+void VoxelGrid::setLeafSize(float leaf_size) {
+  leaf_size_ = leaf_size;
+  inv_leaf_size_ = 1.0f / leaf_size;
+}
+
+size_t VoxelGrid::findSlot(uint64_t key) const {
+  const size_t mask = table_.size() - 1;
+  size_t slot = hashKey(key, mask);
+  while (table_[slot].stamp == stamp_ && table_[slot].key != key) {
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+void VoxelGrid::grow() {
+  std::vector<Voxel> voxels;
+  voxels.reserve(occupied_.size());
+  for (auto slot : occupied_) {
+    voxels.push_back(table_[slot]);
+  }
+  table_.assign(table_.size() * 2, Voxel{});
+  for (size_t i = 0; i < voxels.size(); i++) {
+    const size_t slot = findSlot(voxels[i].key);
+    table_[slot] = voxels[i];
+    occupied_[i] = static_cast<uint32_t>(slot);
+  }
+}
+
+size_t VoxelGrid::filter(const uint8_t *in, size_t count, size_t in_step, uint8_t *out,
+                         size_t out_step) {
+  if (table_.empty()) {
+    table_.assign(INITIAL_TABLE_SIZE, Voxel{});
+  }
+  // Slots stamped by a previous frame count as empty, so the table is never cleared.
+  if (++stamp_ == 0) {
+    for (auto &voxel : table_) {
+      voxel.stamp = 0;
+    }
+    stamp_ = 1;
+  }
+  occupied_.clear();
+  const bool centroid = selection_ == VoxelSelection::CENTROID;
+  for (size_t i = 0; i < count; i++) {
+    float point[3];
+    memcpy(point, in + i * in_step, sizeof(point));
+    if (!std::isfinite(point[0]) || !std::isfinite(point[1]) || !std::isfinite(point[2])) {
+      continue;
+    }
+    const uint64_t key = voxelKey(point[0], point[1], point[2], inv_leaf_size_);
+    size_t slot = findSlot(key);
+    Voxel &voxel = table_[slot];
+    if (voxel.stamp != stamp_) {
+      voxel = Voxel{key, stamp_, 1, point[0], point[1], point[2]};
+      occupied_.push_back(static_cast<uint32_t>(slot));
+      // Keep the load factor at or below 1/2 so probe sequences stay short.
+      if (occupied_.size() * 2 > table_.size()) {
+        grow();
+      }
+    } else if (centroid) {
+      voxel.count++;
+      voxel.x += point[0];
+      voxel.y += point[1];
+      voxel.z += point[2];
+    }
+  }
+  for (size_t i = 0; i < occupied_.size(); i++) {
+    const Voxel &voxel = table_[occupied_[i]];
+    const float scale = 1.0f / static_cast<float>(voxel.count);
+    const float point[4] = {voxel.x * scale, voxel.y * scale, voxel.z * scale, 0.0f};
+    memcpy(out + i * out_step, point, sizeof(point));
+  }
+  return occupied_.size();
+}
+
+}  // namespace orbbec_camera
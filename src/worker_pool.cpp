@@ -0,0 +1,91 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#include "orbbec_camera/worker_pool.h"
+
+namespace orbbec_camera {
+
+WorkerPool::WorkerPool(int thread_num) {
+  for (int i = 0; i < thread_num; i++) {
+    threads_.emplace_back([this]() { workerLoop(); });
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  work_cv_.notify_all();
+  for (auto &thread : threads_) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+}
+
+void WorkerPool::parallelFor(int count, const std::function<void(int)> &task) {
+  if (count <= 0) {
+    return;
+  }
+  if (threads_.empty() || count == 1) {
+    for (int i = 0; i < count; i++) {
+      task(i);
+    }
+    return;
+  }
+  std::lock_guard<std::mutex> job_lock(job_mutex_);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    task_count_ = count;
+    next_task_ = 0;
+    active_workers_ = static_cast<int>(threads_.size());
+    generation_++;
+  }
+  work_cv_.notify_all();
+  runTasks();
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [this]() { return active_workers_ == 0; });
+  task_ = nullptr;
+}
+
+void WorkerPool::workerLoop() {
+  uint64_t generation = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_cv_.wait(lock, [this, generation]() { return stop_ || generation_ != generation; });
+      if (stop_) {
+        return;
+      }
+      generation = generation_;
+    }
+    runTasks();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--active_workers_ == 0) {
+      done_cv_.notify_one();
+    }
+  }
+}
+
+void WorkerPool::runTasks() {
+  for (int i = next_task_++; i < task_count_; i = next_task_++) {
+    (*task_)(i);
+  }
+}
+
+}  // namespace orbbec_camera
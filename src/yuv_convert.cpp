@@ -0,0 +1,452 @@
+/*******************************************************************************
+ * Copyright (c) 2023 Orbbec 3D Technology, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+
+#include "orbbec_camera/yuv_convert.h"
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace orbbec_camera {
+namespace {
+// Copies every other byte of a packed 4:2:2 row, starting at offset 0 (YUYV) or 1 (UYVY).
+void extractPackedLumaRow(const uint8_t *src, uint8_t *dst, int width, int offset) {
+  int x = 0;
+#if defined(__SSE2__)
+  const __m128i low_bytes = _mm_set1_epi16(0x00ff);
+  for (; x + 16 <= width; x += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * x));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * x + 16));
+    if (offset) {
+      a = _mm_srli_epi16(a, 8);
+      b = _mm_srli_epi16(b, 8);
+    } else {
+      a = _mm_and_si128(a, low_bytes);
+      b = _mm_and_si128(b, low_bytes);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_packus_epi16(a, b));
+  }
+#elif defined(__aarch64__)
+  for (; x + 16 <= width; x += 16) {
+    const uint8x16x2_t pixels = vld2q_u8(src + 2 * x);
+    vst1q_u8(dst + x, offset ? pixels.val[1] : pixels.val[0]);
+  }
+#endif
+  for (; x < width; x++) {
+    dst[x] = src[2 * x + offset];
+  }
+}
+
+enum class Layout { YUYV, UYVY, NV12, NV21, I420 };
+
+inline uint8_t clampToByte(int value) {
+  return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+// The arithmetic of the SIMD paths on one pixel. Products keep their high 16
+// bits like _mm_mulhi_epi16, so every path gives the same bytes.
+inline void convertPixel(int y, int u, int v, const YUVConverter::Coefficients &k, bool bgr,
+                         uint8_t *dst) {
+  const int u8 = (u - 128) * 256;
+  const int v8 = (v - 128) * 256;
+  const int y_term = (((y << 8) * k.y) >> 16) + k.y_bias;
+  const int r = (y_term + ((v8 * k.rv) >> 16)) >> 5;
+  const int g = (y_term + (((u8 * k.gu) >> 16) + ((v8 * k.gv) >> 16))) >> 5;
+  const int b = (y_term + ((u8 * k.bu) >> 16)) >> 5;
+  dst[bgr ? 2 : 0] = clampToByte(r);
+  dst[1] = clampToByte(g);
+  dst[bgr ? 0 : 2] = clampToByte(b);
+}
+
+template <Layout L>
+inline void loadPixel(const uint8_t *y_row, const uint8_t *u_row, const uint8_t *v_row, int x,
+                      int &y, int &u, int &v) {
+  const int c = x / 2;
+  switch (L) {
+    case Layout::YUYV:
+      y = y_row[2 * x];
+      u = y_row[4 * c + 1];
+      v = y_row[4 * c + 3];
+      break;
+    case Layout::UYVY:
+      y = y_row[2 * x + 1];
+      u = y_row[4 * c];
+      v = y_row[4 * c + 2];
+      break;
+    case Layout::NV12:
+      y = y_row[x];
+      u = u_row[2 * c];
+      v = u_row[2 * c + 1];
+      break;
+    case Layout::NV21:
+      y = y_row[x];
+      v = u_row[2 * c];
+      u = u_row[2 * c + 1];
+      break;
+    case Layout::I420:
+      y = y_row[x];
+      u = u_row[c];
+      v = v_row[c];
+      break;
+  }
+}
+
+#if defined(__SSE2__)
+// Loads 16 pixels from x as the luma of pixels 0-7 and 8-15 and the 8 chroma
+// samples, all zero-extended to 16 bits.
+template <Layout L>
+inline void loadPixels(const uint8_t *y_row, const uint8_t *u_row, const uint8_t *v_row, int x,
+                       __m128i &y0, __m128i &y1, __m128i &u, __m128i &v) {
+  const __m128i low_bytes = _mm_set1_epi16(0x00ff);
+  const __m128i zero = _mm_setzero_si128();
+  if (L == Layout::YUYV || L == Layout::UYVY) {
+    const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(y_row + 2 * x));
+    const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(y_row + 2 * x + 16));
+    __m128i uv0;
+    __m128i uv1;
+    if (L == Layout::YUYV) {
+      y0 = _mm_and_si128(a, low_bytes);
+      y1 = _mm_and_si128(b, low_bytes);
+      uv0 = _mm_srli_epi16(a, 8);
+      uv1 = _mm_srli_epi16(b, 8);
+    } else {
+      y0 = _mm_srli_epi16(a, 8);
+      y1 = _mm_srli_epi16(b, 8);
+      uv0 = _mm_and_si128(a, low_bytes);
+      uv1 = _mm_and_si128(b, low_bytes);
+    }
+    // uv0 and uv1 hold U, V pairs as 32-bit lanes.
+    u = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(uv0, 16), 16),
+                        _mm_srai_epi32(_mm_slli_epi32(uv1, 16), 16));
+    v = _mm_packs_epi32(_mm_srli_epi32(uv0, 16), _mm_srli_epi32(uv1, 16));
+  } else {
+    const __m128i luma = _mm_loadu_si128(reinterpret_cast<const __m128i *>(y_row + x));
+    y0 = _mm_unpacklo_epi8(luma, zero);
+    y1 = _mm_unpackhi_epi8(luma, zero);
+    if (L == Layout::I420) {
+      u = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(u_row + x / 2)),
+                            zero);
+      v = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(v_row + x / 2)),
+                            zero);
+    } else {
+      const __m128i chroma = _mm_loadu_si128(reinterpret_cast<const __m128i *>(u_row + x));
+      u = _mm_and_si128(chroma, low_bytes);
+      v = _mm_srli_epi16(chroma, 8);
+      if (L == Layout::NV21) {
+        std::swap(u, v);
+      }
+    }
+  }
+}
+
+// Packs 4 RGBX pixels with X = 0 into the low 12 bytes.
+inline __m128i packRGBX(__m128i pixels) {
+  const __m128i low_dwords = _mm_set_epi32(0, -1, 0, -1);
+  const __m128i lanes = _mm_or_si128(_mm_and_si128(pixels, low_dwords),
+                                     _mm_slli_epi64(_mm_srli_epi64(pixels, 32), 24));
+  return _mm_or_si128(_mm_move_epi64(lanes), _mm_slli_si128(_mm_srli_si128(lanes, 8), 6));
+}
+
+inline void storePixels(__m128i r, __m128i g, __m128i b, uint8_t *dst) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i rg_low = _mm_unpacklo_epi8(r, g);
+  const __m128i rg_high = _mm_unpackhi_epi8(r, g);
+  const __m128i b_low = _mm_unpacklo_epi8(b, zero);
+  const __m128i b_high = _mm_unpackhi_epi8(b, zero);
+  // Each store spills 4 bytes that the next one overwrites, except the last.
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(dst),
+                   packRGBX(_mm_unpacklo_epi16(rg_low, b_low)));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 12),
+                   packRGBX(_mm_unpackhi_epi16(rg_low, b_low)));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 24),
+                   packRGBX(_mm_unpacklo_epi16(rg_high, b_high)));
+  const __m128i last = packRGBX(_mm_unpackhi_epi16(rg_high, b_high));
+  _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + 36), last);
+  const int tail = _mm_cvtsi128_si32(_mm_srli_si128(last, 8));
+  memcpy(dst + 44, &tail, sizeof(tail));
+}
+
+inline __m128i chromaTerm(__m128i c) {
+  return _mm_xor_si128(_mm_slli_epi16(c, 8), _mm_set1_epi16(-32768));
+}
+
+template <Layout L>
+int convertRowSIMD(const uint8_t *y_row, const uint8_t *u_row, const uint8_t *v_row,
+                   uint8_t *dst, int width, const YUVConverter::Coefficients &k, bool bgr) {
+  const __m128i y_coefficient = _mm_set1_epi16(k.y);
+  const __m128i y_bias = _mm_set1_epi16(k.y_bias);
+  const __m128i rv = _mm_set1_epi16(k.rv);
+  const __m128i gu = _mm_set1_epi16(k.gu);
+  const __m128i gv = _mm_set1_epi16(k.gv);
+  const __m128i bu = _mm_set1_epi16(k.bu);
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i y[2];
+    __m128i u;
+    __m128i v;
+    loadPixels<L>(y_row, u_row, v_row, x, y[0], y[1], u, v);
+    u = chromaTerm(u);
+    v = chromaTerm(v);
+    const __m128i r_chroma = _mm_mulhi_epi16(v, rv);
+    const __m128i g_chroma = _mm_add_epi16(_mm_mulhi_epi16(u, gu), _mm_mulhi_epi16(v, gv));
+    const __m128i b_chroma = _mm_mulhi_epi16(u, bu);
+    __m128i r[2];
+    __m128i g[2];
+    __m128i b[2];
+    for (int i = 0; i < 2; i++) {
+      // Each chroma sample covers two neighboring pixels.
+      const __m128i r_c = i ? _mm_unpackhi_epi16(r_chroma, r_chroma)
+                            : _mm_unpacklo_epi16(r_chroma, r_chroma);
+      const __m128i g_c = i ? _mm_unpackhi_epi16(g_chroma, g_chroma)
+                            : _mm_unpacklo_epi16(g_chroma, g_chroma);
+      const __m128i b_c = i ? _mm_unpackhi_epi16(b_chroma, b_chroma)
+                            : _mm_unpacklo_epi16(b_chroma, b_chroma);
+      const __m128i y_term =
+          _mm_add_epi16(_mm_mulhi_epu16(_mm_slli_epi16(y[i], 8), y_coefficient), y_bias);
+      r[i] = _mm_srai_epi16(_mm_add_epi16(y_term, r_c), 5);
+      g[i] = _mm_srai_epi16(_mm_add_epi16(y_term, g_c), 5);
+      b[i] = _mm_srai_epi16(_mm_add_epi16(y_term, b_c), 5);
+    }
+    const __m128i red = _mm_packus_epi16(r[0], r[1]);
+    const __m128i green = _mm_packus_epi16(g[0], g[1]);
+    const __m128i blue = _mm_packus_epi16(b[0], b[1]);
+    if (bgr) {
+      storePixels(blue, green, red, dst + 3 * x);
+    } else {
+      storePixels(red, green, blue, dst + 3 * x);
+    }
+  }
+  return x;
+}
+#elif defined(__aarch64__)
+// Loads 16 pixels from x as the luma of the even and the odd pixels and their
+// 8 chroma samples.
+template <Layout L>
+inline void loadPixels(const uint8_t *y_row, const uint8_t *u_row, const uint8_t *v_row, int x,
+                       uint8x8_t &y_even, uint8x8_t &y_odd, uint8x8_t &u, uint8x8_t &v) {
+  if (L == Layout::YUYV || L == Layout::UYVY) {
+    const uint8x8x4_t pixels = vld4_u8(y_row + 2 * x);
+    const int y_index = L == Layout::YUYV ? 0 : 1;
+    const int u_index = L == Layout::YUYV ? 1 : 0;
+    y_even = pixels.val[y_index];
+    y_odd = pixels.val[y_index + 2];
+    u = pixels.val[u_index];
+    v = pixels.val[u_index + 2];
+  } else {
+    const uint8x8x2_t luma = vld2_u8(y_row + x);
+    y_even = luma.val[0];
+    y_odd = luma.val[1];
+    if (L == Layout::I420) {
+      u = vld1_u8(u_row + x / 2);
+      v = vld1_u8(v_row + x / 2);
+    } else {
+      const uint8x8x2_t chroma = vld2_u8(u_row + x);
+      u = chroma.val[L == Layout::NV12 ? 0 : 1];
+      v = chroma.val[L == Layout::NV12 ? 1 : 0];
+    }
+  }
+}
+
+inline int16x8_t mulhi(int16x8_t a, int16_t b) {
+  return vcombine_s16(vshrn_n_s32(vmull_n_s16(vget_low_s16(a), b), 16),
+                      vshrn_n_s32(vmull_n_s16(vget_high_s16(a), b), 16));
+}
+
+inline int16x8_t chromaTerm(uint8x8_t c) {
+  return veorq_s16(vreinterpretq_s16_u16(vshll_n_u8(c, 8)), vdupq_n_s16(-32768));
+}
+
+inline int16x8_t lumaTerm(uint8x8_t y, const YUVConverter::Coefficients &k) {
+  const uint16x8_t shifted = vshll_n_u8(y, 8);
+  const uint16_t coefficient = static_cast<uint16_t>(k.y);
+  const uint16x8_t product =
+      vcombine_u16(vshrn_n_u32(vmull_n_u16(vget_low_u16(shifted), coefficient), 16),
+                   vshrn_n_u32(vmull_n_u16(vget_high_u16(shifted), coefficient), 16));
+  return vaddq_s16(vreinterpretq_s16_u16(product), vdupq_n_s16(k.y_bias));
+}
+
+inline uint8x16_t interleaveChannel(int16x8_t y_even, int16x8_t y_odd, int16x8_t chroma) {
+  const uint8x8_t even = vqmovun_s16(vshrq_n_s16(vaddq_s16(y_even, chroma), 5));
+  const uint8x8_t odd = vqmovun_s16(vshrq_n_s16(vaddq_s16(y_odd, chroma), 5));
+  const uint8x8x2_t zipped = vzip_u8(even, odd);
+  return vcombine_u8(zipped.val[0], zipped.val[1]);
+}
+
+template <Layout L>
+int convertRowSIMD(const uint8_t *y_row, const uint8_t *u_row, const uint8_t *v_row,
+                   uint8_t *dst, int width, const YUVConverter::Coefficients &k, bool bgr) {
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    uint8x8_t y_even;
+    uint8x8_t y_odd;
+    uint8x8_t u8;
+    uint8x8_t v8;
+    loadPixels<L>(y_row, u_row, v_row, x, y_even, y_odd, u8, v8);
+    const int16x8_t u = chromaTerm(u8);
+    const int16x8_t v = chromaTerm(v8);
+    const int16x8_t even = lumaTerm(y_even, k);
+    const int16x8_t odd = lumaTerm(y_odd, k);
+    uint8x16x3_t pixels;
+    pixels.val[bgr ? 2 : 0] = interleaveChannel(even, odd, mulhi(v, k.rv));
+    pixels.val[1] = interleaveChannel(even, odd, vaddq_s16(mulhi(u, k.gu), mulhi(v, k.gv)));
+    pixels.val[bgr ? 0 : 2] = interleaveChannel(even, odd, mulhi(u, k.bu));
+    vst3q_u8(dst + 3 * x, pixels);
+  }
+  return x;
+}
+#endif
+
+template <Layout L>
+void convertRow(const uint8_t *y_row, const uint8_t *u_row, const uint8_t *v_row, uint8_t *dst,
+                int width, const YUVConverter::Coefficients &k, bool bgr) {
+  int x = 0;
+#if defined(__SSE2__) || defined(__aarch64__)
+  x = convertRowSIMD<L>(y_row, u_row, v_row, dst, width, k, bgr);
+#endif
+  for (; x < width; x++) {
+    int y;
+    int u;
+    int v;
+    loadPixel<L>(y_row, u_row, v_row, x, y, u, v);
+    convertPixel(y, u, v, k, bgr, dst + 3 * x);
+  }
+}
+
+template <Layout L>
+void convertFrame(const uint8_t *src, int width, int height, uint8_t *dst, size_t dst_step,
+                  const YUVConverter::Coefficients &k, bool bgr) {
+  const size_t luma_size = static_cast<size_t>(width) * height;
+  for (int y = 0; y < height; y++) {
+    const uint8_t *y_row;
+    const uint8_t *u_row = nullptr;
+    const uint8_t *v_row = nullptr;
+    if (L == Layout::YUYV || L == Layout::UYVY) {
+      y_row = src + static_cast<size_t>(y) * width * 2;
+    } else if (L == Layout::I420) {
+      y_row = src + static_cast<size_t>(y) * width;
+      u_row = src + luma_size + static_cast<size_t>(y / 2) * (width / 2);
+      v_row = u_row + luma_size / 4;
+    } else {
+      y_row = src + static_cast<size_t>(y) * width;
+      u_row = src + luma_size + static_cast<size_t>(y / 2) * width;
+    }
+    convertRow<L>(y_row, u_row, v_row, dst + y * dst_step, width, k, bgr);
+  }
+}
+
+int16_t toFixedPoint(double value, double scale) {
+  return static_cast<int16_t>(std::lround(value * scale));
+}
+}  // namespace
+
+void YUVConverter::setup(Matrix matrix, bool full_range, bool bgr) {
+  const double kr = matrix == Matrix::BT709 ? 0.2126 : 0.299;
+  const double kb = matrix == Matrix::BT709 ? 0.0722 : 0.114;
+  const double kg = 1.0 - kr - kb;
+  const double y_scale = full_range ? 1.0 : 255.0 / 219.0;
+  const double c_scale = full_range ? 1.0 : 255.0 / 224.0;
+  const double y_offset = full_range ? 0.0 : 16.0;
+  // Luma and chroma products come out in 1/32 units with Q13 coefficients.
+  const double one = 8192.0;
+  coefficients_.y = toFixedPoint(y_scale, one);
+  coefficients_.y_bias = static_cast<int16_t>(16 - std::lround(y_offset * coefficients_.y / 256.0));
+  coefficients_.rv = toFixedPoint(2.0 * (1.0 - kr) * c_scale, one);
+  coefficients_.gu = toFixedPoint(-2.0 * kb * (1.0 - kb) / kg * c_scale, one);
+  coefficients_.gv = toFixedPoint(-2.0 * kr * (1.0 - kr) / kg * c_scale, one);
+  coefficients_.bu = toFixedPoint(2.0 * (1.0 - kb) * c_scale, one);
+  bgr_ = bgr;
+}
+
+bool YUVConverter::convert(const uint8_t *src, size_t src_size, OBFormat format, int width,
+                           int height, uint8_t *dst, size_t dst_step) const {
+  if (!hasLumaPlane(format) || width % 2 != 0) {
+    return false;
+  }
+  const bool packed = format == OB_FORMAT_YUYV || format == OB_FORMAT_YUY2 ||
+                      format == OB_FORMAT_UYVY;
+  if (!packed && height % 2 != 0) {
+    return false;
+  }
+  const size_t luma_size = static_cast<size_t>(width) * height;
+  if (src_size < (packed ? luma_size * 2 : luma_size * 3 / 2)) {
+    return false;
+  }
+  const Coefficients &k = coefficients_;
+  switch (format) {
+    case OB_FORMAT_YUYV:
+    case OB_FORMAT_YUY2:
+      convertFrame<Layout::YUYV>(src, width, height, dst, dst_step, k, bgr_);
+      break;
+    case OB_FORMAT_UYVY:
+      convertFrame<Layout::UYVY>(src, width, height, dst, dst_step, k, bgr_);
+      break;
+    case OB_FORMAT_NV12:
+      convertFrame<Layout::NV12>(src, width, height, dst, dst_step, k, bgr_);
+      break;
+    case OB_FORMAT_NV21:
+      convertFrame<Layout::NV21>(src, width, height, dst, dst_step, k, bgr_);
+      break;
+    default:
+      convertFrame<Layout::I420>(src, width, height, dst, dst_step, k, bgr_);
+      break;
+  }
+  return true;
+}
+
+bool hasLumaPlane(OBFormat format) {
+  switch (format) {
+    case OB_FORMAT_YUYV:
+    case OB_FORMAT_YUY2:
+    case OB_FORMAT_UYVY:
+    case OB_FORMAT_NV12:
+    case OB_FORMAT_NV21:
+    case OB_FORMAT_I420:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool extractLuma(const uint8_t *src, size_t src_size, OBFormat format, int width, int height,
+                 uint8_t *dst, size_t dst_step) {
+  if (!hasLumaPlane(format)) {
+    return false;
+  }
+  const bool packed = format == OB_FORMAT_YUYV || format == OB_FORMAT_YUY2 ||
+                      format == OB_FORMAT_UYVY;
+  const size_t src_step = static_cast<size_t>(width) * (packed ? 2 : 1);
+  if (src_size < src_step * height) {
+    return false;
+  }
+  for (int y = 0; y < height; y++) {
+    if (packed) {
+      extractPackedLumaRow(src + y * src_step, dst + y * dst_step, width,
+                           format == OB_FORMAT_UYVY ? 1 : 0);
+    } else {
+      // The planar formats start with the full resolution Y plane.
+      memcpy(dst + y * dst_step, src + y * src_step, width);
+    }
+  }
+  return true;
+}
+
+}  // namespace orbbec_camera